@@ -0,0 +1,30 @@
+/*
+ *	host/avr/eeprom.h - stand-in for <avr/eeprom.h> in the host (linux) build
+ *
+ *		the EEPROM is an array in host/hostcore.c (erased, all 0xff, at start, unless it's
+ *		loaded from a file - see host_eepromfile()).  these functions read and write it
+ *		straight away.  (EECR, etc - in host/avr/io.h - write it a byte at a time, like the AVR.)
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.
+ *
+ */
+
+#ifndef _HOST_AVR_EEPROM_H_
+#define _HOST_AVR_EEPROM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define E2END		511			// atmega88: 512 bytes
+
+uint8_t eeprom_read_byte(const uint8_t *addr);
+void eeprom_write_byte(uint8_t *addr, uint8_t value);
+void eeprom_update_byte(uint8_t *addr, uint8_t value);
+void eeprom_read_block(void *dst, const void *src, size_t n);
+void eeprom_write_block(const void *src, void *dst, size_t n);
+void eeprom_update_block(const void *src, void *dst, size_t n);
+
+#endif
@@ -0,0 +1,28 @@
+/*
+ *	host/avr/interrupt.h - stand-in for <avr/interrupt.h> in the host (linux) build
+ *
+ *		an ISR is an ordinary function, called from the ISR thread in host/hostcore.c.
+ *		cli() waits for a running ISR to finish, so code between cli() and sei() (or
+ *		SREG = sreg) is atomic with respect to the ISR, just like on the AVR.
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.
+ *
+ */
+
+#ifndef _HOST_AVR_INTERRUPT_H_
+#define _HOST_AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+#define ISR(vector)		void vector(void); void vector(void)
+
+void host_cli(void);
+void host_sei(void);
+
+#define cli()	host_cli()
+#define sei()	host_sei()
+
+#endif
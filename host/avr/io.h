@@ -0,0 +1,171 @@
+/*
+ *	host/avr/io.h - stand-in for <avr/io.h> in the host (linux) build
+ *
+ *		the atmega88 I/O registers we use are plain variables here.  host/hostcore.c runs the
+ *		timer1 interrupt and keeps the PINx registers up to date (see there).
+ *
+ *		only the registers and bits that miggl and simone actually touch are declared.
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		add the USART registers (UCSR0A, etc) and vectors.  UDR0 is 16 bits here (see hostcore.c).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add the EEPROM registers (EECR, etc) and EE_READY_vect.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add the watchdog registers.  reading TCNT1 gives the time into the current tick.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add pin change interrupt and sleep registers.
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.
+ *
+ */
+
+#ifndef _HOST_AVR_IO_H_
+#define _HOST_AVR_IO_H_
+
+#include <stdint.h>
+
+#define _BV(bit)	(1 << (bit))
+
+// the status register is per thread: the ISR thread runs with interrupts off, like the AVR does
+extern _Thread_local volatile uint8_t SREG;
+
+extern volatile uint8_t PORTB, PORTC, PORTD;
+extern volatile uint8_t PINB, PINC, PIND;
+extern volatile uint8_t DDRB, DDRC, DDRD;
+
+extern volatile uint8_t TCCR1A, TCCR1B, TIMSK1;
+extern volatile uint16_t ICR1, OCR1A;
+#define TCNT1	host_tcnt1()		// (read only - see host/hostcore.c)
+uint16_t host_tcnt1(void);
+
+extern volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+extern volatile uint8_t SMCR;
+extern volatile uint8_t MCUSR, WDTCSR;
+extern volatile uint8_t EECR, EEDR;
+extern volatile uint16_t EEAR;
+extern volatile uint8_t UCSR0A, UCSR0B, UCSR0C;
+extern volatile uint16_t UBRR0;
+extern volatile uint16_t UDR0;		// (0x100 and up is "nothing written")
+
+// port bits
+#define PB0		0
+#define PB1		1
+#define PB2		2
+#define PB3		3
+#define PB4		4
+#define PB5		5
+#define PB6		6
+#define PB7		7
+
+#define PC0		0
+#define PC1		1
+#define PC2		2
+#define PC3		3
+#define PC4		4
+#define PC5		5
+#define PC6		6
+
+#define PD0		0
+#define PD1		1
+#define PD2		2
+#define PD3		3
+#define PD4		4
+#define PD5		5
+#define PD6		6
+#define PD7		7
+
+// timer1 bits
+#define WGM10	0
+#define WGM11	1
+#define COM1B0	4
+#define COM1B1	5
+#define COM1A0	6
+#define COM1A1	7
+
+#define CS10	0
+#define CS11	1
+#define CS12	2
+#define WGM12	3
+#define WGM13	4
+
+#define TOIE1	0
+#define OCIE1A	1
+#define OCIE1B	2
+
+// pin change interrupt bits
+#define PCIE0	0
+#define PCIE1	1
+#define PCIE2	2
+
+#define PCIF0	0
+#define PCIF1	1
+#define PCIF2	2
+
+// sleep mode control bits
+#define SE		0
+#define SM0		1
+#define SM1		2
+#define SM2		3
+
+// reset flags and watchdog bits
+#define PORF	0
+#define EXTRF	1
+#define BORF	2
+#define WDRF	3
+
+#define WDP0	0
+#define WDP1	1
+#define WDP2	2
+#define WDE		3
+#define WDCE	4
+#define WDP3	5
+#define WDIE	6
+#define WDIF	7
+
+// EEPROM control bits
+#define EERE	0
+#define EEPE	1
+#define EEMPE	2
+#define EERIE	3
+
+// USART bits
+#define MPCM0	0
+#define U2X0	1
+#define UPE0	2
+#define DOR0	3
+#define FE0		4
+#define UDRE0	5
+#define TXC0	6
+#define RXC0	7
+
+#define TXB80	0
+#define RXB80	1
+#define UCSZ02	2
+#define TXEN0	3
+#define RXEN0	4
+#define UDRIE0	5
+#define TXCIE0	6
+#define RXCIE0	7
+
+#define UCPOL0	0
+#define UCSZ00	1
+#define UCSZ01	2
+#define USBS0	3
+
+// interrupt vectors (see ISR() in host/avr/interrupt.h)
+#define PCINT0_vect			host_vect_pcint0
+#define PCINT1_vect			host_vect_pcint1
+#define PCINT2_vect			host_vect_pcint2
+#define TIMER1_OVF_vect		host_vect_timer1_ovf
+#define WDT_vect			host_vect_wdt
+#define EE_READY_vect		host_vect_ee_ready
+#define USART_RX_vect		host_vect_usart_rx
+#define USART_UDRE_vect		host_vect_usart_udre
+
+#endif
@@ -0,0 +1,29 @@
+/*
+ *	host/avr/pgmspace.h - stand-in for <avr/pgmspace.h> in the host (linux) build
+ *
+ *		there is only one address space on the host, so "program memory" is just const data.
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.
+ *
+ */
+
+#ifndef _HOST_AVR_PGMSPACE_H_
+#define _HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+
+#define PROGMEM
+#define PGM_P				const char *
+#define PSTR(s)				(s)
+
+#define pgm_read_byte(p)	(*(const uint8_t *)(p))
+#define pgm_read_word(p)	(*(const uint16_t *)(p))
+
+#define printf_P			printf
+#define fprintf_P			fprintf
+#define sprintf_P			sprintf
+
+#endif
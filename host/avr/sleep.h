@@ -0,0 +1,33 @@
+/*
+ *	host/avr/sleep.h - stand-in for <avr/sleep.h> in the host (linux) build
+ *
+ *		sleep_cpu() blocks until an ISR has run since sleep_enable() (see host_sleep in
+ *		host/hostcore.c) - so, as on the AVR, an interrupt that comes between sei() and
+ *		sleep_cpu() still wakes us up.
+ *		in SLEEP_MODE_PWR_DOWN the timer is stopped, so only a pin change wakes us up.
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.
+ *
+ */
+
+#ifndef _HOST_AVR_SLEEP_H_
+#define _HOST_AVR_SLEEP_H_
+
+#include <avr/io.h>
+
+#define SLEEP_MODE_IDLE			0
+#define SLEEP_MODE_PWR_DOWN		_BV(SM1)
+
+void host_sleep_enable(void);
+void host_sleep(void);
+
+#define set_sleep_mode(mode)	(SMCR = (SMCR & ~(_BV(SM0) | _BV(SM1) | _BV(SM2))) | (mode))
+#define sleep_enable()			host_sleep_enable()
+#define sleep_disable()			(SMCR &= ~_BV(SE))
+#define sleep_cpu()				host_sleep()
+#define sleep_mode()			do { sleep_enable(); sleep_cpu(); sleep_disable(); } while (0)
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ *	host/host.h - host (linux) build of miggl programs - emulator interface
+ *
+ *		hostcore.c plays the part of the atmega88: I/O registers, the timer1 interrupt and
+ *		the four switches.  a front end (e.g. termview.c) provides main(), starts the emulator
+ *		with host_start(), then calls the program's own main() - renamed to simone_main()
+ *		by the Makefile.
+ *
+ *		built with HOST_VIRTUAL, there's no ISR thread: time is virtual, and only passes
+ *		when the program waits (a delay, or sleep_cpu) - then the ticks run back to back,
+ *		as fast as the host can go.  (see host/sim.c)
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		add host_uart().
+ *
+ *	- oct 18, 2026 - jesse
+ *		add HOST_VIRTUAL (virtual time).  HOST_TICK_NS comes from TICKHZ.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add host_eepromfile().
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.
+ *
+ */
+
+#ifndef _HOST_H_
+#define _HOST_H_
+
+#include <stdint.h>
+
+#define HOST_TICK_NS	(1000000000UL / TICKHZ)	// timer1 overflow period (TICKHZ is in miggl.h)
+
+#define HOST_NSWITCH	4			// SW1 to SW4
+
+
+// the program being emulated
+int simone_main(void);
+
+// start the ISR thread (call this from the thread that will run simone_main)
+void host_start(void);
+
+// keep the EEPROM in a file: it's read by host_start() (if it exists), and written at exit.
+//	(call before host_start.)
+void host_eepromfile(const char *path);
+
+// connect the UART to file descriptor fd (e.g. a pseudo-terminal): what the program sends is
+//	written to it, and what's read from it is received, at the baud rate.  (call before host_start.)
+void host_uart(int fd);
+
+// hold switch sw (0 to 3 for SW1 to SW4) down for ms milliseconds
+void host_press(uint8_t sw, uint16_t ms);
+
+// ISR ticks since host_start()
+uint64_t host_ticks(void);
+
+// called after every ISR tick, with the I/O pins up to date (e.g. to sample the display).
+// it runs in the ISR thread, so it must be quick.
+extern void (*HostTickHook)(void);
+
+// keep the ISR (and HostTickHook) from running - like cli(), but from any thread
+void host_lock(void);
+void host_unlock(void);
+
+#endif
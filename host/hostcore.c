@@ -0,0 +1,688 @@
+/*
+ *	hostcore.c - host (linux) build of miggl programs - atmega88 emulation
+ *
+ *		the I/O registers are variables, and a thread calls the timer1 overflow ISR every
+ *		HOST_TICK_NS, against the real time clock.  if the thread falls behind (e.g. the
+ *		machine is busy) it catches up by running the missed ticks back to back.
+ *
+ *		interrupts:
+ *			SREG is per thread, so the main program's interrupt flag (bit 7) is its own, and
+ *			the ISR runs with interrupts off.  a tick that comes while the main program has
+ *			interrupts off is latched (like the TOV1 flag) and runs as soon as they are back on.
+ *			cli() takes the ISR lock, so it waits for a running ISR to finish.
+ *
+ *		switches:
+ *			the PINx registers are updated every tick: output pins read back as written, inputs
+ *			read their pullup (PORTx bit) unless the switch on that pin is held down.
+ *
+ *		pin change interrupts and sleep:
+ *			a change on a pin enabled in PCMSKx latches that port's flag, and its ISR runs
+ *			(if PCICR allows) at the end of the tick.  (writes to PCIFR are ignored, so flags
+ *			can't be cleared by hand - at worst, an ISR runs once for nothing.)
+ *			sleep_cpu() waits for any ISR to run.  in power down mode the timer doesn't run,
+ *			so only a pin change wakes the program up.
+ *
+ *		watchdog:
+ *			with WDIE set, WDT_vect runs every 16ms (or as WDP says) of real time - not of
+ *			ticks, since the watchdog has its own oscillator.  WDE (reset) isn't emulated.
+ *			TCNT1 reads as how far real time is into the current tick, in microseconds.
+ *
+ *		virtual time (HOST_VIRTUAL):
+ *			there's no ISR thread.  delays and sleep_cpu() run the ticks themselves, one after
+ *			another, until they're done - so time only passes while the program waits, and
+ *			"real time" (the watchdog, TCNT1) is the tick count.  nothing else changes.
+ *
+ *		EEPROM:
+ *			an array, erased (0xff) at start - or read from a file (host_eepromfile), and
+ *			written back to it at exit.  the avr/eeprom.h functions use it straight away.
+ *			through the registers, setting EEPE writes EEDR to EEAR after 3.4ms (68 ticks),
+ *			and EE_READY_vect runs every tick that EERIE is set and no write is going on.
+ *
+ *		UART:
+ *			bytes go out and come in at the baud rate set by UBRR0 (and U2X0), through a file
+ *			descriptor (host_uart) - nothing is sent or received without one.  every byte time,
+ *			USART_UDRE_vect runs (if UDRIE0 is set) and whatever it writes to UDR0 is sent; then
+ *			one byte is read, put in UDR0, and USART_RX_vect runs (if RXCIE0 is set).  a byte
+ *			that comes while interrupts are off waits for them (no overrun).  the UART doesn't
+ *			take over the display row pins, like it does on the board (see uart.c).
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		emulate the UART (host_uart).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add virtual time (HOST_VIRTUAL), for the simulator.  the tick rate is TICKHZ.
+ *
+ *	- oct 18, 2026 - jesse
+ *		emulate EEPROM writes through the registers (EECR, etc) and EE_READY_vect.  the
+ *		EEPROM can be kept in a file.
+ *
+ *	- oct 18, 2026 - jesse
+ *		emulate the watchdog interrupt, and reading TCNT1.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add the EEPROM.  delays count timer ticks, so they keep in step with the ISR.
+ *
+ *	- oct 18, 2026 - jesse
+ *		emulate pin change interrupts and sleep modes.
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <avr/eeprom.h>
+
+#include "mydefs.h"
+#include "iodefs.h"
+#include "miggl.h"			// for TICKHZ
+
+#include "host.h"
+
+
+// the registers
+_Thread_local volatile uint8_t SREG;
+
+volatile uint8_t PORTB, PORTC, PORTD;
+volatile uint8_t PINB, PINC, PIND;
+volatile uint8_t DDRB, DDRC, DDRD;
+
+volatile uint8_t TCCR1A, TCCR1B, TIMSK1;
+volatile uint16_t ICR1, OCR1A;
+
+volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+volatile uint8_t SMCR;
+volatile uint8_t MCUSR, WDTCSR;
+volatile uint8_t EECR, EEDR;
+volatile uint16_t EEAR;
+volatile uint8_t UCSR0A, UCSR0B, UCSR0C;
+volatile uint16_t UBRR0;
+volatile uint16_t UDR0;
+
+
+// the ISRs (in miggl.c) - the program doesn't have to have the pin change ones
+void TIMER1_OVF_vect(void);
+void PCINT0_vect(void) __attribute__((weak));
+void PCINT1_vect(void) __attribute__((weak));
+void PCINT2_vect(void) __attribute__((weak));
+void WDT_vect(void) __attribute__((weak));
+void EE_READY_vect(void) __attribute__((weak));
+void USART_RX_vect(void) __attribute__((weak));
+void USART_UDRE_vect(void) __attribute__((weak));
+
+
+void (*HostTickHook)(void);
+
+static pthread_mutex_t IsrLock;
+static volatile uint8_t *MainSREG;	// SREG of the thread running the program
+static uint8_t Tov1;				// timer1 overflow flag (latched while interrupts are off)
+static volatile uint64_t Ticks;
+static struct timespec T0;			// real time of tick 0
+
+static uint8_t WdtOn, WdtFlag;
+static uint64_t WdtNext;			// real time (ns since T0) of the next watchdog interrupt
+
+static uint8_t PcFlags;				// pin change flags (PCIF0 to PCIF2)
+static uint8_t LastPin[3];			// PINB, PINC, PIND as of the last tick
+
+static pthread_cond_t WakeCond = PTHREAD_COND_INITIALIZER;
+static uint32_t IsrCount;			// ISRs run so far (wakes up host_sleep)
+static uint32_t SleepMark;			// IsrCount at sleep_enable()
+static uint8_t Sleeping;
+
+#define EE_WRITE_TICKS	68			// 3.4ms to erase and write a byte
+
+static uint8_t Eeprom[E2END+1];
+static uint8_t EeTicks;				// ticks left of the write going on (0 if none)
+static const char *EepromFile;
+
+#define UART_CLOCK		8000000UL	// F_CPU (the baud rate is UART_CLOCK / 16 / (UBRR0 + 1), or / 8 with U2X0)
+
+static int UartFd = -1;
+static uint32_t UartPhase;			// counts up by the baud rate every tick: 10 * TICKHZ is one byte time
+static int UartRx = -1;				// a received byte, waiting for interrupts to be on
+static uint32_t UartLost;			// bytes that couldn't be written
+
+static const uint8_t SwitchPin[HOST_NSWITCH] = { SW1, SW2, SW3, SW4 };
+static volatile uint16_t SwitchHold[HOST_NSWITCH];	// ticks left to hold each switch down
+
+
+// (with virtual time, there's only one thread - no lock needed)
+void host_lock(void)
+{
+#ifndef HOST_VIRTUAL
+	pthread_mutex_lock(&IsrLock);
+#endif
+}
+
+void host_unlock(void)
+{
+#ifndef HOST_VIRTUAL
+	pthread_mutex_unlock(&IsrLock);
+#endif
+}
+
+
+void host_cli(void)
+{
+	host_lock();
+	SREG &= ~0x80;
+	host_unlock();
+}
+
+void host_sei(void)
+{
+	host_lock();
+	SREG |= 0x80;
+	host_unlock();
+}
+
+
+static void tick(void);
+
+
+// real time since T0, in ns
+static uint64_t realns(void)
+{
+#ifdef HOST_VIRTUAL
+	return Ticks * HOST_TICK_NS;
+#else
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (t.tv_sec - T0.tv_sec) * 1000000000ULL + (t.tv_nsec - T0.tv_nsec);
+#endif
+}
+
+
+//
+// TCNT1 (see avr/io.h): how far we are into the current tick (timer1 counts microseconds)
+//
+uint16_t host_tcnt1(void)
+{
+	int64_t ns;
+
+	ns = (int64_t)realns() - (int64_t)(Ticks * HOST_TICK_NS);
+	if (ns < 0) {
+		return 0;
+	}
+	if (ns / 1000 > ICR1) {
+		return ICR1;		// (we're behind)
+	}
+	return ns / 1000;
+}
+
+
+uint64_t host_ticks(void)
+{
+	return Ticks;
+}
+
+
+void host_press(uint8_t sw, uint16_t ms)
+{
+	if (sw < HOST_NSWITCH) {
+		SwitchHold[sw] = (uint16_t)((ms * 1000000UL) / HOST_TICK_NS);
+	}
+}
+
+
+//
+// EEPROM (see avr/eeprom.h) - addresses are wrapped to the EEPROM size, like the AVR does
+//
+uint8_t eeprom_read_byte(const uint8_t *addr)
+{
+	return Eeprom[(uintptr_t)addr & E2END];
+}
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value)
+{
+	Eeprom[(uintptr_t)addr & E2END] = value;
+}
+
+void eeprom_update_byte(uint8_t *addr, uint8_t value)
+{
+	eeprom_write_byte(addr, value);
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		((uint8_t *)dst)[i] = eeprom_read_byte((const uint8_t *)src + i);
+	}
+}
+
+void eeprom_write_block(const void *src, void *dst, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		eeprom_write_byte((uint8_t *)dst + i, ((const uint8_t *)src)[i]);
+	}
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n)
+{
+	eeprom_write_block(src, dst, n);
+}
+
+
+//
+// keep the EEPROM in a file
+//
+static void saveeeprom(void)
+{
+	FILE *f;
+
+	host_lock();
+	f = fopen(EepromFile, "wb");
+	if (f == NULL || fwrite(Eeprom, 1, sizeof(Eeprom), f) != sizeof(Eeprom)) {
+		perror(EepromFile);
+	}
+	if (f != NULL) {
+		fclose(f);
+	}
+	host_unlock();
+}
+
+void host_eepromfile(const char *path)
+{
+	EepromFile = path;
+}
+
+static void loadeeprom(void)
+{
+	FILE *f;
+
+	f = fopen(EepromFile, "rb");
+	if (f != NULL) {
+		if (fread(Eeprom, 1, sizeof(Eeprom), f) != sizeof(Eeprom)) {
+			memset(Eeprom, 0xff, sizeof(Eeprom));		// not an EEPROM image
+		}
+		fclose(f);
+	}
+	atexit(saveeeprom);
+}
+
+
+void host_uart(int fd)
+{
+	UartFd = fd;
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+
+//
+// busy wait (see util/delay.h)
+//
+// with interrupts on, this counts timer ticks (like a delay loop on the AVR, it runs off the
+// same clock as the timer), so the program's delays keep in step with the ISR even when
+// the host is too busy to run the ISR thread in real time.  (sub-tick delays add up.)
+// with interrupts off, the ISR can't run, so it just waits for real time to pass.
+// (with virtual time, it runs the ticks - the timer overflow waits, if interrupts are off.)
+//
+void host_delay_ns(unsigned long ns)
+{
+	static _Thread_local unsigned long owed;		// ns waited for, but not yet a whole tick
+	struct timespec t0, t;
+	unsigned long d;
+	uint64_t until;
+
+#ifdef HOST_VIRTUAL
+	owed += ns;
+	until = Ticks + owed / HOST_TICK_NS;
+	owed %= HOST_TICK_NS;
+	while (Ticks < until) {
+		tick();
+	}
+	return;
+#endif
+
+	if (SREG & 0x80) {
+		owed += ns;
+		until = Ticks + owed / HOST_TICK_NS;
+		owed %= HOST_TICK_NS;
+
+		t.tv_sec = 0;
+		t.tv_nsec = HOST_TICK_NS / 4;
+		while (Ticks < until) {
+			nanosleep(&t, NULL);		// (let the ISR thread have the CPU)
+		}
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &t);
+		d = (t.tv_sec - t0.tv_sec) * 1000000000UL + (t.tv_nsec - t0.tv_nsec);
+	} while (d < ns);
+}
+
+
+//
+// update the PINx registers from PORTx, DDRx and the switches
+//
+static void updatepins(void)
+{
+	uint8_t down[3] = { 0, 0, 0 };		// PORTB, PORTC, PORTD
+	uint8_t i, pin;
+
+	for (i = 0; i < HOST_NSWITCH; i++) {
+		if (SwitchHold[i] != 0) {
+			SwitchHold[i]--;
+			pin = SwitchPin[i];
+			down[(pin >> 3) - 1] |= _BV(pin & 7);
+		}
+	}
+
+	PINB = (PORTB & DDRB) | (PORTB & ~DDRB & ~down[0]);
+	PINC = (PORTC & DDRC) | (PORTC & ~DDRC & ~down[1]);
+	PIND = (PORTD & DDRD) | (PORTD & ~DDRD & ~down[2]);
+}
+
+
+void host_sleep_enable(void)
+{
+	host_lock();
+	SMCR |= _BV(SE);
+	SleepMark = IsrCount;
+	host_unlock();
+}
+
+
+//
+// sleep_cpu(): wait for an ISR (if sleep is enabled)
+//
+void host_sleep(void)
+{
+	if (!(SMCR & _BV(SE))) {
+		return;
+	}
+
+	host_lock();
+	Sleeping = 1;
+	while (IsrCount == SleepMark) {
+#ifdef HOST_VIRTUAL
+		tick();
+#else
+		pthread_cond_wait(&WakeCond, &IsrLock);
+#endif
+	}
+	Sleeping = 0;
+	host_unlock();
+}
+
+
+static inline uint8_t powereddown(void)
+{
+	return Sleeping && (SMCR & (_BV(SM0) | _BV(SM1) | _BV(SM2))) == SLEEP_MODE_PWR_DOWN;
+}
+
+
+//
+// latch pin change flags, then run the pin change ISRs that are due
+//
+static uint8_t pinchanges(void)
+{
+	void (*vect[3])(void) = { PCINT0_vect, PCINT1_vect, PCINT2_vect };
+	uint8_t pin[3], msk[3];
+	uint8_t i, ran;
+
+	pin[0] = PINB;		msk[0] = PCMSK0;
+	pin[1] = PINC;		msk[1] = PCMSK1;
+	pin[2] = PIND;		msk[2] = PCMSK2;
+
+	ran = 0;
+	for (i = 0; i < 3; i++) {
+		if ((pin[i] ^ LastPin[i]) & msk[i]) {
+			PcFlags |= _BV(i);
+		}
+		LastPin[i] = pin[i];
+
+		if ((PcFlags & _BV(i)) && (PCICR & _BV(i)) && (*MainSREG & 0x80)) {
+			PcFlags &= ~_BV(i);
+			if (vect[i]) {
+				vect[i]();
+				ran = 1;
+			}
+		}
+	}
+	return ran;
+}
+
+
+//
+// run the watchdog interrupt, if it's due.  returns 1 if it ran.
+//
+static uint8_t watchdog(void)
+{
+	uint64_t now, period;
+
+	if (!(WDTCSR & _BV(WDIE))) {
+		WdtOn = 0;
+		WdtFlag = 0;
+		return 0;
+	}
+
+	now = realns();
+	period = 16000000ULL << ((WDTCSR & 0x07) | ((WDTCSR & _BV(WDP3)) >> 2));
+	if (!WdtOn) {
+		WdtOn = 1;
+		WdtNext = now + period;
+	} else if (now >= WdtNext) {
+		WdtFlag = 1;
+		WdtNext += period;
+	}
+
+	if (WdtFlag && (*MainSREG & 0x80)) {
+		WdtFlag = 0;
+		if (WDT_vect) {
+			WDT_vect();
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+//
+// run the EEPROM write, and the EEPROM ready interrupt.  returns 1 if it ran.
+//
+static uint8_t eeprom(void)
+{
+	if (EECR & _BV(EEPE)) {
+		if (EeTicks == 0) {
+			EeTicks = EE_WRITE_TICKS;		// (a new write)
+		} else if (--EeTicks == 0) {
+			Eeprom[EEAR & E2END] = EEDR;
+			EECR &= ~(_BV(EEPE) | _BV(EEMPE));
+		}
+		return 0;
+	}
+
+	if ((EECR & _BV(EERIE)) && (*MainSREG & 0x80) && EE_READY_vect) {
+		EE_READY_vect();
+		return 1;
+	}
+	return 0;
+}
+
+
+//
+// send and receive, a byte time at a time.  returns 1 if an ISR ran.
+//
+static uint8_t uart(void)
+{
+	uint32_t baud;
+	uint8_t c, ran = 0;
+
+	if (UartFd < 0 || !(UCSR0B & (_BV(TXEN0) | _BV(RXEN0)))) {
+		UartPhase = 0;
+		return 0;
+	}
+
+	baud = UART_CLOCK / ((UCSR0A & _BV(U2X0)) ? 8 : 16) / (UBRR0 + 1);
+	UartPhase += baud;
+	if (UartPhase < 10UL * TICKHZ) {
+		return 0;
+	}
+	UartPhase -= 10UL * TICKHZ;
+	if (UartPhase >= 10UL * TICKHZ) {
+		UartPhase = 0;				// (faster than we can tick: a byte a tick)
+	}
+
+	UCSR0A |= _BV(UDRE0);
+	if ((UCSR0B & _BV(TXEN0)) && (UCSR0B & _BV(UDRIE0)) && (*MainSREG & 0x80) && USART_UDRE_vect) {
+		UDR0 = 0x100;
+		USART_UDRE_vect();
+		ran = 1;
+		if (UDR0 < 0x100) {
+			c = UDR0;
+			if (write(UartFd, &c, 1) != 1) {
+				UartLost++;			// (nobody on the other end, or it isn't keeping up)
+			}
+		}
+	}
+
+	if (UCSR0B & _BV(RXEN0)) {
+		if (UartRx < 0 && read(UartFd, &c, 1) == 1) {
+			UartRx = c;
+		}
+		if (UartRx >= 0 && (UCSR0B & _BV(RXCIE0)) && (*MainSREG & 0x80) && USART_RX_vect) {
+			UDR0 = UartRx;
+			UartRx = -1;
+			USART_RX_vect();
+			ran = 1;
+		}
+	}
+	return ran;
+}
+
+
+static void tick(void)
+{
+	uint8_t ran = 0;
+
+	host_lock();
+
+	if (!powereddown()) {			// (the timer's clock is stopped in power down)
+		if (TIMSK1 & _BV(TOIE1)) {
+			Tov1 = 1;
+		}
+		if (Tov1 && (*MainSREG & 0x80)) {
+			Tov1 = 0;
+			TIMER1_OVF_vect();
+			ran = 1;
+		}
+	}
+
+	updatepins();
+	ran |= pinchanges();
+	ran |= watchdog();			// (the watchdog runs in power down too)
+	ran |= eeprom();			// (so do EEPROM writes)
+	if (!powereddown()) {
+		ran |= uart();
+	}
+
+	if (ran) {
+		IsrCount++;
+		if (Sleeping) {
+			pthread_cond_broadcast(&WakeCond);
+		}
+	}
+
+	if (HostTickHook) {
+		HostTickHook();
+	}
+	Ticks++;
+
+	host_unlock();
+}
+
+
+#ifndef HOST_VIRTUAL
+static void *isrthread(void *arg)
+{
+	struct timespec t;
+	uint64_t due;
+
+	prctl(PR_SET_TIMERSLACK, 1UL);		// we sleep for 50us at a time
+
+	for (;;) {
+		clock_gettime(CLOCK_MONOTONIC, &t);
+		due = ((t.tv_sec - T0.tv_sec) * 1000000000ULL + (t.tv_nsec - T0.tv_nsec)) / HOST_TICK_NS;
+
+		if (due > Ticks + 1000000000ULL / HOST_TICK_NS) {
+			// more than a second behind (e.g. stopped in a debugger) - don't try to catch up
+			T0.tv_sec += (due - Ticks) * HOST_TICK_NS / 1000000000ULL;
+			continue;
+		}
+
+		while (Ticks < due) {
+			tick();
+		}
+
+		// sleep until the next tick is due
+		t.tv_sec = T0.tv_sec + ((Ticks + 1) * HOST_TICK_NS) / 1000000000ULL;
+		t.tv_nsec = T0.tv_nsec + ((Ticks + 1) * HOST_TICK_NS) % 1000000000ULL;
+		if (t.tv_nsec >= 1000000000L) {
+			t.tv_sec++;
+			t.tv_nsec -= 1000000000L;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL);
+	}
+
+	return NULL;
+}
+#endif
+
+
+void host_start(void)
+{
+	pthread_mutexattr_t attr;
+#ifndef HOST_VIRTUAL
+	pthread_t th;
+#endif
+
+	// recursive, so that code called from the ISR can still do cli()
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&IsrLock, &attr);
+
+	memset(Eeprom, 0xff, sizeof(Eeprom));
+	if (EepromFile) {
+		loadeeprom();
+	}
+
+	PORTB = PORTC = PORTD = 0;
+	updatepins();
+	LastPin[0] = PINB;
+	LastPin[1] = PINC;
+	LastPin[2] = PIND;
+
+	MainSREG = &SREG;
+	clock_gettime(CLOCK_MONOTONIC, &T0);
+#ifndef HOST_VIRTUAL
+	if (pthread_create(&th, NULL, isrthread, NULL) != 0) {
+		perror("pthread_create");
+		exit(1);
+	}
+#endif
+}
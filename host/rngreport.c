@@ -0,0 +1,253 @@
+/*
+ *	rngreport.c - host (linux) build of miggl programs - random number generator report
+ *
+ *		compares simone's generator (xorshift16 with random_below, see simone.c) with the
+ *		one it replaced (Jegge's (Tri2s) nibble multiply generators, with %), and prints:
+ *			- speed: ns and host cycles per call
+ *			- uniformity: chi-squared of 1,000,000 numbers for a few ranges, and of
+ *			  pairs of arrows in a row (range 4) - what the game actually uses
+ *			- period: the cycles of the whole 16 bit state space, and the cycle the
+ *			  default seed is on
+ *
+ *		it's a report, not a pass/fail test.  chi-squared values well over the 1% column
+ *		mean the numbers aren't uniform.  (a generator that goes around its whole cycle
+ *		several times in SAMPLES numbers, like xorshift16, comes out near 0.)
+ *
+ *		note: the speeds are for the host, which divides in hardware.  on the AVR, the %
+ *		is a call to avr-gcc's 16 bit software division (a couple of hundred cycles), which
+ *		is most of what the old generator costs there.
+ *
+ *		run: make rngreport && ./simone-rngreport
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.
+ *
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "mydefs.h"
+
+
+// simone.c (its main is simone_main, which isn't called)
+uint16_t xorshift16(uint16_t *s);
+uint8_t random_below(uint16_t *s, uint8_t max);
+
+
+#define SAMPLES		1000000UL
+#define SPEED_CALLS	20000000UL
+
+
+//
+// the old generator: two nibble multiply generators, state a (high byte) and b (low byte)
+//
+static uint16_t jegge_step(uint16_t s)
+{
+	uint8_t a = s >> 8, b = s & 0xff;
+
+	a = 0x7F * (a & 0x0F) + (a >> 4);
+	b = 0x3C * (b & 0x0F) + (b >> 4);
+	return ((uint16_t)a << 8) | b;
+}
+
+static uint8_t jegge_below(uint16_t *s, uint8_t max)
+{
+	*s = jegge_step(*s);
+	return (((*s >> 8) << 4) + (*s & 0xff)) % max;
+}
+
+static uint16_t xorshift_step(uint16_t s)
+{
+	xorshift16(&s);
+	return s;
+}
+
+
+struct gen {
+	const char *name;
+	uint8_t (*below)(uint16_t *s, uint8_t max);
+	uint16_t (*step)(uint16_t s);
+	uint16_t seed;
+};
+
+static struct gen Gens[] = {
+	{ "jegge %",         jegge_below,  jegge_step,    0x110D },
+	{ "xorshift16 mask", random_below, xorshift_step, 0x110D },
+};
+#define NGENS	(sizeof(Gens) / sizeof(Gens[0]))
+
+
+static double nowns(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static uint64_t cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+
+//
+// chi-squared 1% critical value for df degrees of freedom (Wilson-Hilferty)
+//
+static double chi2crit(unsigned df)
+{
+	double k = 2.0 / (9.0 * df);
+
+	return df * pow(1.0 - k + 2.3263 * sqrt(k), 3);
+}
+
+static double chi2(const unsigned long *count, unsigned cells, unsigned long n)
+{
+	double e = (double)n / cells, x = 0.0, d;
+	unsigned i;
+
+	for (i = 0; i < cells; i++) {
+		d = count[i] - e;
+		x += d * d / e;
+	}
+	return x;
+}
+
+
+static void speed(struct gen *g, uint8_t max)
+{
+	volatile uint8_t sink;
+	uint16_t s = g->seed;
+	uint64_t c0;
+	double t0;
+	unsigned long i;
+
+	t0 = nowns();
+	c0 = cycles();
+	for (i = 0; i < SPEED_CALLS; i++) {
+		sink = g->below(&s, max);
+	}
+	printf("    range %3u: %6.2f ns  %6.1f cycles per call\n", max,
+		(nowns() - t0) / SPEED_CALLS, (double)(cycles() - c0) / SPEED_CALLS);
+	(void)sink;
+}
+
+static void uniformity(struct gen *g, uint8_t max)
+{
+	static unsigned long count[256];
+	uint16_t s = g->seed;
+	unsigned long i;
+	double x;
+
+	memset(count, 0, sizeof(count));
+	for (i = 0; i < SAMPLES; i++) {
+		count[g->below(&s, max)]++;
+	}
+	x = chi2(count, max, SAMPLES);
+	printf("    range %3u: chi2 %10.1f  (df %3u, 1%% %6.1f)  %s\n", max, x, max - 1,
+		chi2crit(max - 1), x > chi2crit(max - 1) ? "NOT UNIFORM" : "ok");
+}
+
+static void pairs(struct gen *g)
+{
+	unsigned long count[16];
+	uint16_t s = g->seed;
+	uint8_t prev, r;
+	unsigned long i;
+	double x;
+
+	memset(count, 0, sizeof(count));
+	prev = g->below(&s, 4);
+	for (i = 0; i < SAMPLES; i++) {
+		r = g->below(&s, 4);
+		count[prev * 4 + r]++;
+		prev = r;
+	}
+	x = chi2(count, 16, SAMPLES);
+	printf("    arrow pairs: chi2 %10.1f  (df  15, 1%% %6.1f)  %s\n", x, chi2crit(15),
+		x > chi2crit(15) ? "NOT UNIFORM" : "ok");
+}
+
+
+//
+// find every cycle of the state map.  prints how many there are, the shortest and longest,
+// and the length of the one the seed ends up on (and how many steps it takes to get there).
+//
+static void period(struct gen *g)
+{
+	static uint32_t mark[65536];	// 0 unseen, else the walk that saw it (walk << 1) | on a cycle
+	static uint32_t dist[65536];	// steps from the start of that walk
+	static uint32_t cyclen[65536];	// cycle length, for states on a cycle
+	uint32_t walk, ncycles = 0, minlen = 0xffffffff, maxlen = 0, len, i;
+	uint32_t s, x, tail;
+
+	memset(mark, 0, sizeof(mark));
+	for (walk = 1, i = 0; i < 65536; i++, walk++) {
+		if (mark[i]) {
+			continue;
+		}
+		// walk until we reach a state we've seen
+		for (s = i, len = 0; !mark[s]; s = g->step(s), len++) {
+			mark[s] = walk << 1;
+			dist[s] = len;
+		}
+		if ((mark[s] >> 1) == walk) {
+			// it's our own walk: a new cycle
+			len -= dist[s];
+			ncycles++;
+			if (len < minlen) minlen = len;
+			if (len > maxlen) maxlen = len;
+			x = s;
+			do {
+				mark[x] |= 1;
+				cyclen[x] = len;
+				x = g->step(x);
+			} while (x != s);
+		}
+	}
+
+	// the seed's cycle
+	for (s = g->seed, tail = 0; !(mark[s] & 1); s = g->step(s)) {
+		tail++;
+	}
+	printf("    %u cycles, %u to %u long.  seed %04x: cycle of %u (after %u steps)\n",
+		ncycles, minlen, maxlen, g->seed, cyclen[s], tail);
+}
+
+
+int main(void)
+{
+	static const uint8_t ranges[] = { 4, 5, 7, 10, 100 };
+	unsigned i, r;
+
+	for (i = 0; i < NGENS; i++) {
+		printf("%s:\n", Gens[i].name);
+		printf("  speed:\n");
+		for (r = 0; r < sizeof(ranges); r++) {
+			speed(&Gens[i], ranges[r]);
+		}
+		printf("  uniformity (%lu numbers):\n", SAMPLES);
+		for (r = 0; r < sizeof(ranges); r++) {
+			uniformity(&Gens[i], ranges[r]);
+		}
+		pairs(&Gens[i]);
+		printf("  period:\n");
+		period(&Gens[i]);
+		printf("\n");
+	}
+	return 0;
+}
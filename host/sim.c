@@ -0,0 +1,412 @@
+/*
+ *	sim.c - host (linux) build of miggl programs - headless simulator, with a bot player
+ *
+ *		runs simone (simone_main) against the emulated atmega88 in virtual time (hostcore.c
+ *		built with HOST_VIRTUAL, and the ISR at TICKHZ = 1000 - see the Makefile), with a bot
+ *		pressing the switches, for as many games as asked.  there's no display and no sound,
+ *		and no waiting: a 20 second game takes a few ms.  then it prints a report:
+ *			- speed: games, virtual time and ISR ticks per (real) second
+ *			- levels reached: a histogram
+ *			- by level: how long the playback (first arrow on to last arrow off) and the
+ *			  input (last arrow off to the last press) took, on average
+ *			- direction balance: how often each arrow came up, with chi-squared
+ *			- anything the game did that the bot didn't expect (e.g. a game over after a
+ *			  right answer, or a playback that didn't repeat the one before it)
+ *
+ *		the bot plays like a person would, by watching the display (Disp[]): a green arrow
+ *		(no red) is part of the playback - it remembers the new one at the end, waits a
+ *		reaction time after the last one goes off, then presses them all back.  each press
+ *		is wrong with the --error chance (so the games end), and the last press of level
+ *		--maxlevel is always wrong.  after a game over it waits for the score, then presses
+ *		the button for --mode to start the next game.  its timing jitters (from --seed), so
+ *		the games' seeds differ (see miggl-seed.c) - but the same options give the same run.
+ *
+ *		it's a report, not a pass/fail test - but "unexpected" should always be 0, and the
+ *		direction balance should be ok.
+ *
+ *		options:
+ *			--games N      - games to play (default 1000)
+ *			--error PCT    - chance of a wrong press, in percent (default 5)
+ *			--maxlevel N   - lose on purpose at this level (default 50, at most MAXLEVELS)
+ *			--mode MODE    - normal, relaxed or fast (default normal)
+ *			--seed N       - the bot's random seed (default 1)
+ *
+ *		run: make sim && ./simone-sim --games 5000
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.
+ *
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <avr/io.h>
+
+#include "mydefs.h"
+#include "iodefs.h"
+#include "miggl.h"
+
+#include "host.h"
+
+
+#define MAXLEVELS		1000		// longest game the bot can remember
+
+#define BOOT_PRESS_MS	500			// first press (skips the intro, and picks the mode)
+#define PRESS_MS		40			// how long the bot holds a switch down
+#define REACT_MS		300			// from the last arrow going off to the first press (+ jitter)
+#define PRESS_GAP_MS	150			// between presses (+ jitter)
+#define JITTER_MS		50
+#define RESTART_MS		1700		// from a game over to the press that starts the next game
+#define START_WAIT_MS	500			// from that press to watching (the intro or score goes away,
+									// and the first arrow comes on a second after the press)
+#define STUCK_MS		30000		// nothing happened for this long - the game is stuck
+
+// simone.c (its main is simone_main)
+void draw_arrow(byte dir, byte clr);
+
+// what the bot is doing
+#define BOT_START		0			// waiting to press the mode button
+#define BOT_WATCH		1			// watching the playback
+#define BOT_INPUT		2			// pressing the arrows back
+
+static uint8_t Bot = BOT_START;
+static uint32_t Ms;					// virtual time (ms)
+static uint32_t NextMs;				// when the bot does the next thing (start, watch, input)
+static uint32_t LastSeen;			// last time something happened (for STUCK_MS)
+static uint8_t ModeSwitch;			// switch that picks the mode
+static uint8_t WasArrow;			// an arrow was on the display, last ms
+static uint16_t Level;				// level being played (arrows in the playback)
+static uint16_t Seen;				// arrows seen so far in this playback, or pressed so far
+static uint8_t Seq[MAXLEVELS];		// the arrows, as seen
+static uint32_t PlayStart, PlayEnd;	// this level's playback: first arrow on, last arrow off
+
+static disprow_t Arrows[4][YSCREEN];	// what each arrow looks like (green rows)
+
+// options
+static unsigned long NGames = 1000;
+static double ErrorPct = 5.0;
+static unsigned MaxLevel = 50;
+static uint32_t BotRandom = 1;
+
+// results
+static unsigned long Games;
+static unsigned long Reached[MAXLEVELS + 1];		// games that ended at each level
+static unsigned long LevelCount[MAXLEVELS + 1];		// playbacks of each level
+static uint64_t PlayMs[MAXLEVELS + 1], InputMs[MAXLEVELS + 1];
+static uint64_t TotalPlayMs, TotalInputMs;
+static unsigned long DirCount[4];
+static unsigned long Unexpected;
+
+
+// the bot's random numbers (xorshift32)
+static uint32_t botrandom(void)
+{
+	BotRandom ^= BotRandom << 13;
+	BotRandom ^= BotRandom >> 17;
+	BotRandom ^= BotRandom << 5;
+	return BotRandom;
+}
+
+static uint32_t jitter(void)
+{
+	return botrandom() % JITTER_MS;
+}
+
+
+//
+// the report
+//
+static double nowns(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static double StartNs;
+
+static void report(void)
+{
+	double wall, x, e, d;
+	unsigned long n, most;
+	unsigned i, top;
+
+	wall = (nowns() - StartNs) / 1e9;
+
+	printf("%lu games in %.2f s: %.0f games/s, %.0fx real time (%.2f M ticks/s at %u Hz)\n",
+		Games, wall, Games / wall, Ms / 1000.0 / wall, host_ticks() / wall / 1e6, TICKHZ);
+	printf("virtual time %.1f s: playback %.1f s, input %.1f s\n",
+		Ms / 1000.0, TotalPlayMs / 1000.0, TotalInputMs / 1000.0);
+	printf("unexpected: %lu\n\n", Unexpected);
+
+	// levels reached
+	top = 0;
+	most = 1;
+	n = 0;
+	for (i = 1; i <= MAXLEVELS; i++) {
+		if (Reached[i] != 0) {
+			top = i;
+			n += (unsigned long)i * Reached[i];
+			if (Reached[i] > most) {
+				most = Reached[i];
+			}
+		}
+	}
+	printf("levels reached (mean %.2f):\n", Games ? (double)n / Games : 0.0);
+	for (i = 1; i <= top; i++) {
+		if (Reached[i] != 0) {
+			printf("  %4u %7lu  %.*s\n", i, Reached[i], (int)(50 * Reached[i] / most),
+				"##################################################");
+		}
+	}
+
+	printf("\nby level (mean ms):   playback    input\n");
+	for (i = 1; i <= top && i <= 20; i++) {
+		if (LevelCount[i] != 0) {
+			printf("  %4u %7lu     %8.1f %8.1f\n", i, LevelCount[i],
+				(double)PlayMs[i] / LevelCount[i], (double)InputMs[i] / LevelCount[i]);
+		}
+	}
+
+	// direction balance: chi-squared, 3 degrees of freedom (1% critical value 11.34)
+	n = DirCount[0] + DirCount[1] + DirCount[2] + DirCount[3];
+	e = n / 4.0;
+	x = 0.0;
+	for (i = 0; i < 4; i++) {
+		d = DirCount[i] - e;
+		x += e ? d * d / e : 0.0;
+	}
+	printf("\ndirections: A %lu  B %lu  C %lu  D %lu  chi2 %.2f (df 3, 1%% 11.34)  %s\n",
+		DirCount[0], DirCount[1], DirCount[2], DirCount[3], x, x > 11.34 ? "NOT UNIFORM" : "ok");
+}
+
+
+//
+// the bot
+//
+static void press(uint8_t sw)
+{
+	host_press(sw, PRESS_MS);
+	LastSeen = Ms;
+}
+
+// the game is over (at Level) - start the next one, or stop
+static void gameover(void)
+{
+	Games++;
+	Reached[Level]++;
+	if (Games == NGames) {
+		report();
+		exit(Unexpected ? 1 : 0);
+	}
+	Bot = BOT_START;
+	NextMs = Ms + RESTART_MS + jitter();
+}
+
+// which arrow is on the display: 0 to 3, 4 for none, 5 for something else
+static uint8_t lookatdisplay(void)
+{
+	uint8_t y, d, any = 0;
+
+	for (y = 0; y < YSCREEN; y++) {
+		if (Disp[y + YSCREEN] != 0) {
+			return 5;			// red: not part of a playback
+		}
+		any |= (Disp[y] != 0);
+	}
+	if (!any) {
+		return 4;
+	}
+	for (d = 0; d < 4; d++) {
+		for (y = 0; y < YSCREEN && Disp[y] == Arrows[d][y]; y++)
+			;
+		if (y == YSCREEN) {
+			return d;
+		}
+	}
+	return 5;
+}
+
+static void botwatch(void)
+{
+	uint8_t d;
+
+	if (Ms < NextMs) {
+		return;
+	}
+	d = lookatdisplay();
+	if (d == 5) {
+		// red (not yellow - that's the last press's feedback arrow): the score - we've lost
+		for (d = 0; d < YSCREEN && (Disp[d + YSCREEN] & ~Disp[d]) == 0; d++)
+			;
+		if (d < YSCREEN) {
+			Unexpected++;
+			gameover();
+		}
+		WasArrow = 0;
+		return;
+	}
+
+	if (d < 4 && !WasArrow) {
+		// an arrow just came on
+		if (Seen == 0) {
+			PlayStart = Ms;
+		}
+		if (Seen == Level - 1) {
+			Seq[Seen] = d;			// the new one
+			DirCount[d]++;
+		}
+		else if (Seen >= Level || Seq[Seen] != d) {
+			Unexpected++;			// not the same as last time
+		}
+		Seen++;
+		LastSeen = Ms;
+	}
+	else if (d == 4 && WasArrow && Seen == Level) {
+		// the last arrow just went off: our turn
+		PlayEnd = Ms;
+		Seen = 0;
+		Bot = BOT_INPUT;
+		NextMs = Ms + REACT_MS + jitter();
+	}
+	WasArrow = (d < 4);
+}
+
+static void botinput(void)
+{
+	uint8_t d, wrong;
+
+	if (Ms < NextMs) {
+		return;
+	}
+
+	d = Seq[Seen];
+	wrong = (Seen == Level - 1 && Level >= MaxLevel) ||
+		(botrandom() % 1000000) < (uint32_t)(ErrorPct * 10000);
+	if (wrong) {
+		d = (d + 1 + botrandom() % 3) & 3;
+	}
+	press(d);			// (SW1 to SW4 are arrows A to D)
+	NextMs = Ms + PRESS_GAP_MS + jitter();
+
+	if (!wrong && ++Seen < Level) {
+		return;
+	}
+
+	// this level is done
+	LevelCount[Level]++;
+	PlayMs[Level] += PlayEnd - PlayStart;
+	InputMs[Level] += Ms - PlayEnd;
+	TotalPlayMs += PlayEnd - PlayStart;
+	TotalInputMs += Ms - PlayEnd;
+
+	if (wrong) {
+		gameover();
+		return;
+	}
+	Level++;
+	Seen = 0;
+	WasArrow = 0;
+	Bot = BOT_WATCH;
+}
+
+// ISR tick hook: one step of the bot every (virtual) millisecond
+static void botstep(void)
+{
+	if (host_ticks() % (TICKHZ / 1000) != 0) {
+		return;
+	}
+	Ms++;
+
+	switch (Bot) {
+	case BOT_START:
+		if (Ms >= NextMs) {
+			press(ModeSwitch);
+			Level = 1;
+			Seen = 0;
+			WasArrow = 0;
+			Bot = BOT_WATCH;
+			NextMs = Ms + START_WAIT_MS;
+		}
+		break;
+	case BOT_WATCH:
+		botwatch();
+		break;
+	case BOT_INPUT:
+		botinput();
+		break;
+	}
+
+	if (Ms - LastSeen > STUCK_MS) {
+		fprintf(stderr, "stuck at %u ms (game %lu, level %u, bot %u)\n", Ms, Games + 1, Level, Bot);
+		report();
+		exit(2);
+	}
+}
+
+
+static void usage(const char *prg)
+{
+	fprintf(stderr, "usage: %s [--games N] [--error PCT] [--maxlevel N] "
+		"[--mode normal|relaxed|fast] [--seed N]\n", prg);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	static const char *modes[] = { "normal", "relaxed", "fast" };
+	uint8_t d, y;
+	int i;
+
+	for (i = 1; i < argc; i += 2) {
+		if (i + 1 >= argc) {
+			usage(argv[0]);
+		}
+		if (strcmp(argv[i], "--games") == 0) {
+			NGames = strtoul(argv[i + 1], NULL, 0);
+		} else if (strcmp(argv[i], "--error") == 0) {
+			ErrorPct = atof(argv[i + 1]);
+		} else if (strcmp(argv[i], "--maxlevel") == 0) {
+			MaxLevel = strtoul(argv[i + 1], NULL, 0);
+		} else if (strcmp(argv[i], "--seed") == 0) {
+			BotRandom = strtoul(argv[i + 1], NULL, 0);
+		} else if (strcmp(argv[i], "--mode") == 0) {
+			for (ModeSwitch = 0; ModeSwitch < 3 && strcmp(argv[i + 1], modes[ModeSwitch]) != 0; ModeSwitch++)
+				;
+			if (ModeSwitch == 3) {
+				usage(argv[0]);
+			}
+		} else {
+			usage(argv[0]);
+		}
+	}
+	if (NGames == 0 || MaxLevel == 0 || MaxLevel > MAXLEVELS || BotRandom == 0) {
+		usage(argv[0]);
+	}
+
+	host_start();		// (virtual time: nothing runs until simone_main waits)
+
+	// learn what the arrows look like
+	for (d = 0; d < 4; d++) {
+		cleardisplay();
+		draw_arrow(d, GREEN);
+		for (y = 0; y < YSCREEN; y++) {
+			Arrows[d][y] = Disp[y];
+		}
+	}
+	cleardisplay();
+
+	NextMs = BOOT_PRESS_MS;
+	HostTickHook = botstep;
+	StartNs = nowns();
+
+	simone_main();		// (never returns - botstep exits when it's done)
+	return 0;
+}
@@ -0,0 +1,434 @@
+/*
+ *	termview.c - host (linux) build of miggl programs - ANSI terminal display viewer
+ *
+ *		runs the program (simone_main) against the emulated atmega88 in hostcore.c, and shows
+ *		the display in the terminal, along with the frame timing and task statistics.
+ *
+ *		the viewer doesn't look at Disp[] - it watches the row and column pins on every ISR
+ *		tick, so it shows what the LEDs would actually show (overlay, scan mode and all).
+ *		each pixel's brightness is its on time since the last redraw.
+ *
+ *		keys:
+ *			1 to 4 - press SW1 to SW4
+ *			r      - reset the frame, latency and task statistics
+ *			q      - quit
+ *
+ *		options:
+ *			--record FILE  - record the game (see miggl-session.c) into FILE, written at exit
+ *			--replay FILE  - replay a game recorded with --record
+ *			--eeprom FILE  - keep the EEPROM (high scores, etc) in FILE, from one run to the next
+ *			--uart new     - connect the UART to a new pseudo-terminal (its name is printed), and
+ *			                 hold SW2 + SW3 at power up, so simone links up (head to head)
+ *			--uart DEVICE  - the same, with an existing tty (e.g. the pty another one printed)
+ *
+ *		for a head to head game on one machine:
+ *			./simone-host --uart new		(shows e.g. "uart /dev/pts/5")
+ *			./simone-host --uart /dev/pts/5		(in another terminal)
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		the task statistics are only there with MIGGL_TASKSTATS.
+ *
+ *	- oct 18, 2026 - jesse
+ *		show the main loop's task statistics (see miggl-run.c).  r resets them too.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add --uart, and show the link statistics.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add --eeprom.
+ *
+ *	- oct 18, 2026 - jesse
+ *		show the random seed and what seedinit() cost.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add --record and --replay.
+ *
+ *	- oct 18, 2026 - jesse
+ *		show the press-to-feedback latency (MIGGL_LATENCY).
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <termios.h>
+#include <fcntl.h>
+
+#include <avr/io.h>
+
+#include "mydefs.h"
+#include "iodefs.h"
+#include "miggl.h"
+
+#include "host.h"
+
+
+#define REDRAW_MS		20			// redraw rate (50 Hz)
+#define PRESS_MS		150			// how long a key holds its switch down (terminals have no key up)
+#define LINKPRESS_MS	500			// --uart: how long SW2 + SW3 are held at power up
+
+
+// LED on time, per plane (0 green, 1 red), since the last redraw (updated by sampledisplay)
+static uint32_t OnTicks[2][YSCREEN][XSCREEN];
+static uint32_t SampleTicks;
+
+// session recording (--record / --replay)
+static uint8_t SessionBuf[4096];
+static const char *RecordFile;
+
+static char UartName[64];			// --uart
+
+static struct termios SavedTerm;
+static uint8_t RawTerm;
+
+
+//
+// ISR tick hook: add the pixels that are lit right now to OnTicks
+//
+static inline void samplecolumn(uint8_t plane, uint8_t y, disprow_t bits)
+{
+	uint8_t x;
+
+	for (x = 0; x < XSCREEN; x++) {
+		if (bits & XBIT(x)) {
+			OnTicks[plane][y][x]++;
+		}
+	}
+}
+
+#define _SAMPLE_GREEN(n, pin)	if (input_test(pin)) samplecolumn(0, (n), bits);
+#define _SAMPLE_RED(n, pin)		if (input_test(pin)) samplecolumn(1, (n), bits);
+
+static void sampledisplay(void)
+{
+	disprow_t bits;
+
+	bits = DISP_READROW();
+	if (bits != 0) {
+		DISP_GREENCOLS(_SAMPLE_GREEN)
+		DISP_REDCOLS(_SAMPLE_RED)
+	}
+	SampleTicks++;
+}
+
+
+static void restoreterm(void)
+{
+	if (RawTerm) {
+		tcsetattr(STDIN_FILENO, TCSANOW, &SavedTerm);
+		RawTerm = 0;
+	}
+	printf("\033[0m\033[?25h\n");		// normal colors, show cursor
+	fflush(stdout);
+}
+
+static void onsignal(int sig)
+{
+	exit(1);		// (restoreterm runs at exit)
+}
+
+static void setupterm(void)
+{
+	struct termios t;
+
+	if (isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &SavedTerm) == 0) {
+		t = SavedTerm;
+		t.c_lflag &= ~(ICANON | ECHO);		// one key at a time, no echo (ISIG stays on for ^C)
+		t.c_cc[VMIN] = 0;
+		t.c_cc[VTIME] = 0;
+		tcsetattr(STDIN_FILENO, TCSANOW, &t);
+		RawTerm = 1;
+	}
+	atexit(restoreterm);
+	signal(SIGINT, onsignal);
+	signal(SIGTERM, onsignal);
+
+	printf("\033[2J\033[?25l");		// clear screen, hide cursor
+}
+
+
+#ifdef MIGGL_LATENCY
+//
+// one line of press-to-feedback latency: min/avg/max in ms, and the histogram
+//
+static void showlatency(uint8_t which, const char *name)
+{
+	struct latencystats ls;
+	uint8_t b;
+
+	getlatency(which, &ls);
+	printf("  %-7s latency  n %4u  min %5.2f  avg %5.2f  max %5.2f ms  |", name, ls.count,
+		ls.min * HOST_TICK_NS / 1e6, ls.count ? ls.sum * (HOST_TICK_NS / 1e6) / ls.count : 0.0,
+		ls.max * HOST_TICK_NS / 1e6);
+	for (b = 0; b < LAT_BUCKETS; b++) {
+		printf(" %u", ls.hist[b]);
+	}
+	printf("\033[K\n");
+}
+#endif
+
+
+#ifdef MIGGL_TASKSTATS
+//
+// the main loop's tasks (miggl_run): runs, average and longest run time, and how much of
+//	the time the CPU had nothing to do
+//
+static void showtasks(void)
+{
+	static const char *names[NTASKS] = { "frame", "button", "timer0", "timer1", "timer2", "timer3", "idle" };
+	struct taskstats ts;
+	uint64_t busy = 0, idle;
+	uint8_t t;
+
+	printf("  tasks");
+	for (t = 0; t < TASK_IDLE; t++) {
+		gettaskstats(t, &ts);
+		busy += ts.sum;
+		if (ts.runs != 0) {
+			printf("  %s %lu avg %.2f max %.2f ms", names[t], (unsigned long)ts.runs,
+				ts.sum * (HOST_TICK_NS / 1e6) / ts.runs, ts.max * HOST_TICK_NS / 1e6);
+		}
+	}
+	gettaskstats(TASK_IDLE, &ts);
+	idle = ts.sum;
+	printf("  %s %.1f%%\033[K\n", names[TASK_IDLE], busy + idle ? 100.0 * idle / (busy + idle) : 0.0);
+}
+#endif
+
+
+//
+// draw the display, one pixel is two character cells wide.
+// a pixel that was on for a full phase of every scan cycle is drawn at full brightness.
+//
+static void redraw(uint32_t on[2][YSCREEN][XSCREEN], uint32_t ticks, double fps)
+{
+	struct framestats fs;
+	struct linkstats ls;
+	uint32_t full;
+	uint16_t g, r;
+	uint8_t x, y;
+
+	full = ticks / DISPROWS;		// on time of one 10 phase scan phase
+	if (full == 0) {
+		full = 1;
+	}
+
+	printf("\033[H\n");
+	for (y = 0; y < YSCREEN; y++) {
+		printf("  ");
+		for (x = 0; x < XSCREEN; x++) {
+			g = (uint16_t)((on[0][y][x] * 255UL) / full);
+			r = (uint16_t)((on[1][y][x] * 255UL) / full);
+			if (g > 255) g = 255;
+			if (r > 255) r = 255;
+			if (g == 0 && r == 0) {
+				printf("\033[48;2;32;32;32m  ");			// unlit LED
+			} else {
+				printf("\033[48;2;%u;%u;0m  ", r, g);
+			}
+			printf("\033[0m ");
+		}
+		printf("\n\n");
+	}
+
+	getframestats(&fs);
+	printf("  %5.1f fps  presented %5u  missed %5u  worst %3u ms  last %3u ms  tick %5u  %s\033[K\n",
+		fps, fs.presented, fs.missed, fs.worst, fs.last, gettick(), isaudioplaying() ? "(audio)" : "");
+#ifdef MIGGL_LATENCY
+	showlatency(LAT_DISPLAY, "display");
+	showlatency(LAT_AUDIO, "audio");
+#endif
+#ifdef MIGGL_TASKSTATS
+	showtasks();
+#endif
+	printf("  seed %04x  seedinit %u us  %s\033[K\n", getseed(), getseedcost(),
+		getsession() == SES_REPLAY ? "replaying" : "");
+	if (islinkon()) {
+		getlinkstats(&ls);
+		printf("  uart %s  link %s  sent %5u  resent %4u  received %5u  crc errors %4u  restarts %u\033[K\n",
+			UartName, linkpeer() ? "up  " : "down", ls.sent, ls.resent, ls.received, ls.crcerrors, ls.restarts);
+	}
+	printf("  keys 1-4: SW1-SW4, r: reset stats, q: quit\033[K\n");
+	fflush(stdout);
+}
+
+
+//
+// viewer thread: read keys, redraw every REDRAW_MS
+//
+static void *viewthread(void *arg)
+{
+	static uint32_t on[2][YSCREEN][XSCREEN];
+	struct pollfd pfd;
+	struct timespec t, tfps;
+	struct framestats fs;
+	uint16_t lastpresented = 0;
+	uint32_t ticks;
+	double fps = 0.0, dt;
+	char c;
+
+	clock_gettime(CLOCK_MONOTONIC, &tfps);
+
+	for (;;) {
+		pfd.fd = STDIN_FILENO;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, REDRAW_MS) > 0 && read(STDIN_FILENO, &c, 1) == 1) {
+			if (c >= '1' && c < '1' + HOST_NSWITCH) {
+				host_press(c - '1', PRESS_MS);
+			} else if (c == 'r' || c == 'R') {
+				resetframestats();
+#ifdef MIGGL_TASKSTATS
+				resettaskstats();
+#endif
+#ifdef MIGGL_LATENCY
+				resetlatency();
+#endif
+			} else if (c == 'q' || c == 'Q') {
+				exit(0);
+			}
+		}
+
+		host_lock();
+		memcpy(on, OnTicks, sizeof(on));
+		memset(OnTicks, 0, sizeof(OnTicks));
+		ticks = SampleTicks;
+		SampleTicks = 0;
+		host_unlock();
+
+		// frame rate, over about a second
+		clock_gettime(CLOCK_MONOTONIC, &t);
+		dt = (t.tv_sec - tfps.tv_sec) + (t.tv_nsec - tfps.tv_nsec) / 1e9;
+		if (dt >= 1.0) {
+			getframestats(&fs);
+			fps = (uint16_t)(fs.presented - lastpresented) / dt;
+			lastpresented = fs.presented;
+			tfps = t;
+		}
+
+		redraw(on, ticks, fps);
+	}
+
+	return NULL;
+}
+
+
+//
+// write the recording out at exit (--record)
+//
+static void saverecording(void)
+{
+	FILE *f;
+	uint16_t len;
+
+	len = endsession();
+	if (len == 0) {
+		return;
+	}
+	f = fopen(RecordFile, "wb");
+	if (f == NULL || fwrite(SessionBuf, 1, len, f) != len) {
+		perror(RecordFile);
+	}
+	if (f != NULL) {
+		fclose(f);
+	}
+}
+
+//
+// --uart: open a new pseudo-terminal (name is "new"), or a tty, raw
+//
+static int openuart(const char *name)
+{
+	struct termios t;
+	int fd;
+
+	if (strcmp(name, "new") == 0) {
+		fd = posix_openpt(O_RDWR | O_NOCTTY);
+		if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+			perror("posix_openpt");
+			exit(1);
+		}
+		name = ptsname(fd);
+	}
+	else {
+		fd = open(name, O_RDWR | O_NOCTTY);
+		if (fd < 0) {
+			perror(name);
+			exit(1);
+		}
+	}
+	snprintf(UartName, sizeof(UartName), "%s", name);
+	if (tcgetattr(fd, &t) == 0) {
+		cfmakeraw(&t);
+		tcsetattr(fd, TCSANOW, &t);
+	}
+	return fd;
+}
+
+static void usage(const char *prg)
+{
+	fprintf(stderr, "usage: %s [--record FILE | --replay FILE] [--eeprom FILE] [--uart new | --uart DEVICE]\n", prg);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t th;
+	FILE *f;
+	size_t len;
+	int i;
+
+	for (i = 1; i < argc; i += 2) {
+		if (i + 1 >= argc) {
+			usage(argv[0]);
+		}
+		if (strcmp(argv[i], "--record") == 0 && getsession() == SES_OFF) {
+			RecordFile = argv[i + 1];
+			setsession(SES_RECORD, SessionBuf, sizeof(SessionBuf));
+			atexit(saverecording);
+		} else if (strcmp(argv[i], "--replay") == 0 && getsession() == SES_OFF) {
+			f = fopen(argv[i + 1], "rb");
+			if (f == NULL) {
+				perror(argv[i + 1]);
+				return 1;
+			}
+			len = fread(SessionBuf, 1, sizeof(SessionBuf), f);
+			fclose(f);
+			setsession(SES_REPLAY, SessionBuf, len);
+		} else if (strcmp(argv[i], "--eeprom") == 0) {
+			host_eepromfile(argv[i + 1]);
+		} else if (strcmp(argv[i], "--uart") == 0) {
+			host_uart(openuart(argv[i + 1]));
+			host_press(1, LINKPRESS_MS);		// SW2 + SW3: link up (see simone.c)
+			host_press(2, LINKPRESS_MS);
+		} else {
+			usage(argv[0]);
+		}
+	}
+
+	setupterm();
+
+	HostTickHook = sampledisplay;
+	host_start();
+
+	if (pthread_create(&th, NULL, viewthread, NULL) != 0) {
+		perror("pthread_create");
+		return 1;
+	}
+
+	simone_main();
+
+	pthread_join(th, NULL);		// the program returned: keep showing the display until 'q'
+	return 0;
+}
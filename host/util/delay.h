@@ -0,0 +1,21 @@
+/*
+ *	host/util/delay.h - stand-in for <util/delay.h> in the host (linux) build
+ *
+ *		like the real ones, these are busy waits (so they show up as cpu time in a profile).
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.
+ *
+ */
+
+#ifndef _HOST_UTIL_DELAY_H_
+#define _HOST_UTIL_DELAY_H_
+
+void host_delay_ns(unsigned long ns);
+
+#define _delay_us(us)	host_delay_ns((unsigned long)((us) * 1000.0))
+#define _delay_ms(ms)	host_delay_ns((unsigned long)((ms) * 1000000.0))
+
+#endif
@@ -24,6 +24,18 @@
  *
  *	revision history:
  *
+ *	- oct 18, 2026 - jesse
+ *		add DISP_UARTROWS and LINK_XSCREEN.  DISP_WRITEROW leaves the _RowPinsHeld pins high.
+ *
+ *	- oct 18, 2026 - jesse
+ *		note that the UART pins are ROW1 and ROW2.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add DISP_READROW (host build).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add the display pin map (DISP_GREENCOLS, DISP_REDCOLS, DISP_WRITEROW) used by the scan code.
+ *
  *	- apr 18, 2008 - rolf
  *		minor fix to input_test() to eliminate compiler warning.
  *		(control reaches end of non-void function)
@@ -49,7 +61,10 @@
 //
 // project-specific pin definitions go here.
 //
-// note: TxD (PD1) is used for the UART (as an output), so doesn't need to be declared here
+// note: RxD (PD0) and TxD (PD1) are also ROW1 and ROW2.  while the UART is on (see uart.c,
+// miggl-link.c) it has those pins, so the right two columns of the display (x = 5, 6) show
+// the serial lines instead of the picture.  the display scan leaves them alone then (see
+// DISP_UARTROWS), and games should only draw in x < LINK_XSCREEN.
 //
 // note: changes here MUST be updated in avrinit() too!  (see PORTn and DDRn settings)
 //
@@ -80,6 +95,28 @@
 #define SW4			_PD+PD7		/* input w/ pullup */
 
 
+//
+// display pin map (used by the display scan in miggl.c)
+//
+// DISP_GREENCOLS and DISP_REDCOLS list the column pins, one per display line (top line first),
+// as X(line, pin) - there must be exactly YSCREEN of each.
+// DISP_WRITEROW puts the pixels of one row (XSCREEN bits, x = 0 is the highest bit) on the row pins.
+//
+// note: PD7 is SW4, so we keep it high (its pullup) when writing the row pins.
+// the row pins in _RowPinsHeld (miggl.c) are kept high too - linkinit() puts DISP_UARTROWS
+// there, so the scan doesn't touch the UART's pins (for RxD, high is its pullup).
+//
+
+#define DISP_UARTROWS		0x03		/* row pins that are RxD and TxD (x = 6, 5) */
+#define LINK_XSCREEN		5			/* columns left for the picture while the UART is on */
+
+#define DISP_GREENCOLS(X)	X(0, GC1) X(1, GC2) X(2, GC3) X(3, GC4) X(4, GC5)
+#define DISP_REDCOLS(X)		X(0, RC1) X(1, RC2) X(2, RC3) X(3, RC4) X(4, RC5)
+
+#define DISP_WRITEROW(bits)	(PORTD = (uint8_t)(bits) | 0x80 | _RowPinsHeld)
+#define DISP_READROW()		(PIND & 0x7f)				/* (for the host display viewer) */
+
+
 //
 // end of project-specific pin definitions.
 //
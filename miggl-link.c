@@ -0,0 +1,498 @@
+/*
+ *	miggl-link.c - Mignonette Game Library - link between two boards, over the UART
+ *
+ *	author(s): jesse fulton (jesse.fulton at gmail dot com) (c) 2010 - Some Rights Reserved
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ *
+ *
+ *	linksend() sends a message - a type (0 to 7) and up to LINK_MAXDATA bytes - and
+ *	linkrecv() gets the other board's, each one once, in order.  lost or damaged frames
+ *	are sent again until they get through.
+ *
+ *	frames (as small as we can make them - a message with no data is 2 bytes):
+ *		1 byte  - header: kind (2 bits), sequence number (3 bits), then 3 bits that are
+ *		          the message type (LK_SHORT), the number of bytes that follow (LK_LONG),
+ *		          or, for LK_ACK, "hello" (bit 0 - see below)
+ *		0 to 7  - LK_LONG only: the message type, then its data
+ *		1 byte  - CRC-8 of the above (starting from 0xff, so a line of 0s isn't a frame)
+ *
+ *	each message frame has the next sequence number (mod 8).  the other board answers
+ *	with an LK_ACK frame holding the sequence number it expects next, which acknowledges
+ *	everything before it.  up to LINK_WINDOW frames can be waiting for that; if it doesn't
+ *	come within LINK_RTO_MS, they're all sent again (the wait doubles every time, up to
+ *	LINK_MAXRTO_MS).  a frame that's out of order, or a repeat, is dropped (and
+ *	acknowledged again).  when there's nothing else to send, an LK_ACK goes out every
+ *	LINK_KEEPALIVE_MS, so each board knows the other is there (linkpeer).
+ *
+ *	until a board has sent its first message, its LK_ACKs say "hello": it has just
+ *	started, and its first message will be number 0.  so when one board restarts, the
+ *	other one starts counting again too - and whatever it had waiting is lost, so that's
+ *	counted in linkstats.restarts (the game has to send it again).  a hello from a board
+ *	that's just starting up - that hasn't said anything else yet, or acknowledged
+ *	anything the hello doesn't - isn't counted.
+ *
+ *	the receiver looks for frames anywhere in the bytes: if a CRC is wrong, it tries
+ *	again from the next byte.  a frame that stops halfway is dropped when the next byte
+ *	comes more than LINK_GAP_MS after it.
+ *
+ *	the timers and sending run from the display ISR, once a millisecond (do_link_isr),
+ *	which also moves what the UART got into RxBytes, and notes where a gap was.  that's
+ *	all the ISR does with it: the frames are found (and their CRCs checked) by
+ *	_linkpoll(), outside the ISR - miggl_run() calls it every time around, and so do
+ *	linkrecv() and linkpeer().  so a message waits at most a millisecond to go out, plus
+ *	its time on the line (2 bytes is about 2ms at 9600 baud), then until the main loop
+ *	gets to it.
+ *
+ *	note: on the Mignonette, the UART pins are display rows (see uart.c).  linkinit() has the
+ *	display scan leave them alone (_RowPinsHeld), and games should only draw in x < LINK_XSCREEN.
+ *
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		linkinit() keeps the display scan off the UART pins.
+ *
+ *	- oct 18, 2026 - jesse
+ *		RxBytes is 16 bytes.  with the UART's 16, that's 30 bytes (30ms at 9600 baud)
+ *		that can wait for _linkpoll - more than a frame callback takes.
+ *
+ *	- oct 18, 2026 - jesse
+ *		find the frames in _linkpoll(), not in the ISR (it only moves the bytes).
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.
+ *
+ *
+ */
+
+#include <inttypes.h>
+#include <avr/io.h>			/* this takes care of definitions for our specific AVR */
+#include <avr/interrupt.h>	/* for cli(), etc */
+#include <stdio.h>			// for NULL, FILE (miggl.h)
+#include <string.h>			// for memcpy, memmove
+
+#include "uart.h"
+
+#include "mydefs.h"
+#include "iodefs.h"
+
+#include "miggl.h"
+#include "miggl-private.h"
+
+
+#define LK_ACK			0			// frame kinds (top 2 bits of the header)
+#define LK_SHORT		1
+#define LK_LONG			2
+
+#define LINK_MAXFRAME	(1 + 1 + LINK_MAXDATA + 1)	// header, type, data, CRC
+#define LINK_CRCINIT	0xff
+
+#define LINK_WINDOW		4			// frames that can be waiting to be acknowledged (power of 2, up to 4)
+#define LINK_RXQ		4			// received messages waiting for linkrecv (must be a power of 2)
+#define LINK_RXBUF		16			// received bytes waiting for _linkpoll (must be a power of 2)
+
+#define BYTE_MS(n)		((n) * 10000UL / UART_BAUD)		// time on the line for n bytes (10 bits each)
+
+#define LINK_RTO_MS		(10 + 2 * BYTE_MS(LINK_MAXFRAME + 2))	// first wait for an LK_ACK (32ms at 9600 baud)
+#define LINK_MAXRTO_MS	500			// longest wait (e.g. while the other board is off)
+#define LINK_GAP_MS		(2 + BYTE_MS(3))	// a frame that stops for this long is dropped
+#define LINK_KEEPALIVE_MS	500		// an LK_ACK this often, if there's nothing else to send
+#define LINK_ALIVE_MS	1500		// linkpeer() gives up on the other board after this long
+
+static volatile uint8_t LinkOn;
+
+// sending (the frames waiting to be acknowledged are kept by sequence number)
+static uint8_t TxFrame[LINK_WINDOW][LINK_MAXFRAME];
+static uint8_t TxLen[LINK_WINDOW];
+static volatile uint8_t TxNext;		// sequence number of the next new frame
+static uint8_t TxBase;				// oldest frame not yet acknowledged
+static uint8_t TxSend;				// next frame to put on the line (TxBase to TxNext)
+static uint16_t TxTimer;			// ms until the frames are sent again (0 if none are out)
+static uint16_t TxRto;				// the wait, now
+static uint16_t IdleMs;				// ms since we last sent anything
+static uint8_t Hello;				// 1 until our first message is sent
+
+// receiving (the ISR adds to RxBytes; the rest of the bytes side is _linkpoll's)
+static uint8_t RxBytes[LINK_RXBUF];
+static volatile uint8_t RxBHead, RxBTail;	// the ISR adds at RxBHead
+static uint8_t RxGap;				// ms since the last byte (ISR)
+static volatile uint8_t RxCut;		// where in RxBytes the last gap was (the byte after it)
+static volatile uint8_t RxCutNew;	// 1 if _linkpoll hasn't got to it yet
+static uint8_t RxFrame[LINK_MAXFRAME];
+static uint8_t RxLen;				// bytes in RxFrame
+
+static uint8_t RxSeq;				// sequence number we expect next
+static uint8_t AckDue;				// 1 if we need to send an LK_ACK
+static uint16_t HeardMs;			// ms since the last good frame
+static uint8_t PeerUp;				// 1 once the other board is past hello (see gothello)
+
+static struct linkmsg RxQueue[LINK_RXQ];
+static volatile uint8_t RxQHead, RxQTail;	// _linkpoll adds at RxQHead
+
+static struct linkstats LinkStats;
+
+
+static uint8_t framecrc(const uint8_t *f, uint8_t n)
+{
+	uint8_t crc = LINK_CRCINIT;
+
+	while (n-- != 0) {
+		crc = _crc8(crc, *f++);
+	}
+	return crc;
+}
+
+
+//
+// start the link (and the UART)
+//
+void linkinit(void)
+{
+	uint8_t sreg;
+
+	sreg = SREG;
+	cli();
+	TxNext = TxBase = TxSend = 0;
+	TxTimer = 0;
+	TxRto = LINK_RTO_MS;
+	IdleMs = 0;
+	RxSeq = 0;
+	RxBHead = RxBTail = 0;
+	RxGap = 0;
+	RxCutNew = 0;
+	RxLen = 0;
+	Hello = 1;
+	AckDue = 1;					// (say hello)
+	HeardMs = 0xffff;
+	PeerUp = 0;
+	RxQHead = RxQTail = 0;
+	memset(&LinkStats, 0, sizeof(LinkStats));
+	_RowPinsHeld = DISP_UARTROWS;	// (the scan mustn't write them now - see iodefs.h)
+	uart_init();
+	LinkOn = 1;
+	SREG = sreg;
+}
+
+uint8_t islinkon(void)
+{
+	return LinkOn;
+}
+
+
+//
+// send a message: type is 0 to 7, with len (0 to LINK_MAXDATA) bytes of data.
+//	returns 0 if there are already LINK_WINDOW messages waiting to get through.
+//
+uint8_t linksend(uint8_t type, const void *data, uint8_t len)
+{
+	uint8_t sreg, *f, n;
+
+	if (!LinkOn || type > 7 || len > LINK_MAXDATA) {		// error check
+		return 0;
+	}
+
+	sreg = SREG;
+	cli();
+	if (((TxNext - TxBase) & 7) >= LINK_WINDOW) {
+		SREG = sreg;
+		return 0;
+	}
+
+	f = TxFrame[TxNext & (LINK_WINDOW-1)];
+	if (len == 0) {
+		f[0] = (LK_SHORT << 6) | (TxNext << 3) | type;
+		n = 1;
+	}
+	else {
+		f[0] = (LK_LONG << 6) | (TxNext << 3) | (len + 1);
+		f[1] = type;
+		memcpy(&f[2], data, len);
+		n = 2 + len;
+	}
+	f[n] = framecrc(f, n);
+	TxLen[TxNext & (LINK_WINDOW-1)] = n + 1;
+	TxNext = (TxNext + 1) & 7;
+	Hello = 0;
+	LinkStats.sent++;
+	SREG = sreg;
+	return 1;
+}
+
+
+//
+// get the next message from the other board.  returns 0 if there isn't one.
+//
+uint8_t linkrecv(struct linkmsg *m)
+{
+	uint8_t sreg;
+
+	_linkpoll();
+	sreg = SREG;
+	cli();
+	if (RxQHead == RxQTail) {
+		SREG = sreg;
+		return 0;
+	}
+	*m = RxQueue[RxQTail];
+	RxQTail = (RxQTail + 1) & (LINK_RXQ-1);
+	SREG = sreg;
+	return 1;
+}
+
+
+//
+// returns 1 if we've heard from the other board lately (in the last LINK_ALIVE_MS)
+//
+uint8_t linkpeer(void)
+{
+	uint8_t sreg;
+	uint16_t ms;
+
+	_linkpoll();
+	sreg = SREG;
+	cli();
+	ms = HeardMs;
+	SREG = sreg;
+	return LinkOn && ms < LINK_ALIVE_MS;
+}
+
+
+// get the link statistics (see struct linkstats)
+void getlinkstats(struct linkstats *ls)
+{
+	uint8_t sreg;
+
+	sreg = SREG;
+	cli();
+	*ls = LinkStats;
+	SREG = sreg;
+}
+
+
+//
+// what a received frame does (interrupts are off - this is shared with the ISR)
+//
+
+// the other board expects seq next: everything before it got through
+static void gotack(uint8_t seq)
+{
+	uint8_t acked;
+
+	acked = (seq - TxBase) & 7;
+	if (acked == 0 || acked > ((TxNext - TxBase) & 7)) {
+		return;			// (nothing new, or nonsense)
+	}
+	if (((TxSend - TxBase) & 7) < acked) {
+		TxSend = seq;
+	}
+	TxBase = seq;
+	TxRto = LINK_RTO_MS;
+	TxTimer = (TxBase != TxNext) ? TxRto : 0;
+}
+
+// the other board says hello (it has just started): it expects seq next, and sends us 0 next
+static void gothello(uint8_t seq)
+{
+	// it restarted if it had said something else - or if it expects a frame we don't have
+	//	(the board before it got that far).  what we had waiting was for that board.
+	if (PeerUp || ((seq - TxBase) & 7) > ((TxNext - TxBase) & 7)) {
+		LinkStats.restarts++;
+		PeerUp = 0;
+		TxBase = TxSend = TxNext = seq;
+		TxTimer = 0;
+	}
+	gotack(seq);
+	RxSeq = 0;
+	AckDue = !Hello;			// (say hello back - unless we're saying it too)
+}
+
+// a good frame, f (n bytes, without the CRC)
+static void gotframe(const uint8_t *f, uint8_t n)
+{
+	uint8_t kind, seq, head;
+	struct linkmsg *m;
+
+	HeardMs = 0;
+	kind = f[0] >> 6;
+	seq = (f[0] >> 3) & 7;
+
+	if (kind == LK_ACK && (f[0] & 1)) {
+		gothello(seq);
+		return;
+	}
+	PeerUp = 1;
+	if (kind == LK_ACK) {
+		gotack(seq);
+		return;
+	}
+
+	AckDue = 1;
+	head = (RxQHead + 1) & (LINK_RXQ-1);
+	if (seq != RxSeq || head == RxQTail) {
+		return;			// a repeat, out of order, or no room (it'll come again)
+	}
+	m = &RxQueue[RxQHead];
+	if (kind == LK_SHORT) {
+		m->type = f[0] & 7;
+		m->len = 0;
+	}
+	else {
+		m->type = f[1];
+		m->len = n - 2;
+		memcpy(m->data, &f[2], m->len);
+	}
+	RxQHead = head;
+	RxSeq = (RxSeq + 1) & 7;
+	LinkStats.received++;
+}
+
+// length of the frame that starts with header h (with its CRC), or 0 if it can't be one
+static inline uint8_t framelen(uint8_t h)
+{
+	switch (h >> 6) {
+	case LK_ACK:
+		return (h & 6) == 0 ? 2 : 0;
+	case LK_SHORT:
+		return 2;
+	case LK_LONG:
+		return (h & 7) >= 2 ? 2 + (h & 7) : 0;
+	}
+	return 0;
+}
+
+// a received byte: look for frames in what we have so far (interrupts are on)
+static void gotbyte(uint8_t c)
+{
+	uint8_t n, skip, sreg;
+
+	RxFrame[RxLen++] = c;
+	while (RxLen != 0) {
+		n = framelen(RxFrame[0]);
+		if (n != 0 && RxLen < n) {
+			return;				// (need more)
+		}
+		if (n != 0 && framecrc(RxFrame, n - 1) == RxFrame[n - 1]) {
+			sreg = SREG;
+			cli();
+			gotframe(RxFrame, n - 1);
+			SREG = sreg;
+			skip = n;
+		}
+		else {
+			LinkStats.crcerrors++;
+			skip = 1;			// try again from the next byte
+		}
+		RxLen -= skip;
+		memmove(RxFrame, &RxFrame[skip], RxLen);
+	}
+}
+
+//
+// find the frames in the bytes received so far (and act on them) - called from the main loop
+//	(miggl_run), linkrecv and linkpeer.  not from the ISR: this is the slow part.
+//
+void _linkpoll(void)
+{
+	uint8_t tail, sreg;
+
+	if (!LinkOn) {
+		return;
+	}
+
+	tail = RxBTail;
+	while (tail != RxBHead) {
+		if (RxCutNew && tail == RxCut) {
+			sreg = SREG;
+			cli();
+			RxCutNew = (tail != RxCut);		// (unless the ISR has just moved it)
+			SREG = sreg;
+			if (RxLen != 0) {
+				RxLen = 0;			// a frame that stopped halfway
+				LinkStats.crcerrors++;
+			}
+		}
+		gotbyte(RxBytes[tail]);
+		tail = (tail + 1) & (LINK_RXBUF-1);
+		RxBTail = tail;
+	}
+}
+
+
+//
+// the ISR part (interrupts are off)
+//
+
+// put frame seq on the line, if there's room
+static uint8_t sendframe(uint8_t seq)
+{
+	uint8_t *f, n;
+
+	f = TxFrame[seq & (LINK_WINDOW-1)];
+	n = TxLen[seq & (LINK_WINDOW-1)];
+	if (uart_txfree() < n) {
+		return 0;
+	}
+	while (n-- != 0) {
+		uart_put(*f++);
+	}
+	IdleMs = 0;
+	return 1;
+}
+
+// link portion of the display ISR - called every millisecond
+void do_link_isr(void)
+{
+	int c;
+	uint8_t ack[2], head;
+
+	if (!LinkOn) {
+		return;
+	}
+
+	// receive: just move the bytes along (_linkpoll looks at them), noting a gap before them
+	//	(if there's no room, the rest wait in the UART's buffer)
+	while ((head = (RxBHead + 1) & (LINK_RXBUF-1)) != RxBTail && (c = uart_get()) >= 0) {
+		if (RxGap > LINK_GAP_MS) {
+			RxCut = RxBHead;
+			RxCutNew = 1;
+		}
+		RxGap = 0;
+		RxBytes[RxBHead] = c;
+		RxBHead = head;
+	}
+	if (RxGap <= LINK_GAP_MS) {
+		RxGap++;
+	}
+	if (HeardMs != 0xffff) {
+		HeardMs++;
+	}
+
+	// time to send the frames again?
+	if (TxTimer != 0 && --TxTimer == 0) {
+		LinkStats.resent += (TxSend - TxBase) & 7;
+		TxSend = TxBase;
+		TxRto = (TxRto >= LINK_MAXRTO_MS / 2) ? LINK_MAXRTO_MS : 2 * TxRto;
+	}
+
+	// send (acknowledgements first)
+	if (++IdleMs >= LINK_KEEPALIVE_MS) {
+		AckDue = 1;
+	}
+	if (AckDue && uart_txfree() >= 2) {
+		ack[0] = (LK_ACK << 6) | (RxSeq << 3) | Hello;
+		ack[1] = framecrc(ack, 1);
+		uart_put(ack[0]);
+		uart_put(ack[1]);
+		AckDue = 0;
+		IdleMs = 0;
+	}
+	while (TxSend != TxNext && sendframe(TxSend)) {
+		TxSend = (TxSend + 1) & 7;
+		if (TxTimer == 0) {
+			TxTimer = TxRto;
+		}
+	}
+}
@@ -0,0 +1,280 @@
+/*
+ *	miggl-nv.c - Mignonette Game Library - saving things in EEPROM, without waiting
+ *
+ *	author(s): jesse fulton (jesse.fulton at gmail dot com) (c) 2010 - Some Rights Reserved
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ *
+ *
+ *	writing a byte of EEPROM takes 3.4ms, so writes are queued (_eequeue), and the
+ *	EEPROM ready interrupt writes them one byte at a time.  nothing waits for them.
+ *	(bytes that already hold the right value are skipped - that's quicker, and saves wear.)
+ *
+ *	nvsave()/nvload() keep one record (the program's saved data - high scores, etc) in
+ *	NV_EE_SIZE bytes of EEPROM, as a log of slots:
+ *		1 byte - sequence number (one more than the slot before)
+ *		size bytes - the record
+ *		1 byte - CRC-8 of the above
+ *	each save goes in the next slot, round and round, so the writes are spread over all of
+ *	them (wear levelling: a 14 byte record gets 18 slots, so 18 times the EEPROM's life).
+ *	the newest slot with a good CRC is the record.  if the power goes while a slot is being
+ *	written, its CRC is wrong, and the one before it is used.
+ *
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		nvload() reads the slots into NvBuf, and nvsave() doesn't need a copy of the record
+ *		(nvload(NULL, ...)), so neither puts NV_MAXDATA bytes on the stack.
+ *
+ *	- oct 18, 2026 - jesse
+ *		_crc8 uses a nibble table, instead of going bit by bit.
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.
+ *
+ *
+ */
+
+#include <inttypes.h>
+#include <avr/io.h>			/* this takes care of definitions for our specific AVR */
+#include <avr/interrupt.h>	/* for cli(), ISR, etc */
+#include <avr/eeprom.h>		/* for eeprom_read_block(), etc */
+#include <avr/pgmspace.h>	/* for PROGMEM, pgm_read_byte */
+#include <stdio.h>			// for NULL, FILE (miggl.h)
+#include <string.h>			// for memcpy
+
+#include "mydefs.h"
+
+#include "miggl.h"
+#include "miggl-private.h"
+
+
+#define EEQ_SIZE		4			// writes that can be queued (must be a power of 2)
+
+
+// queued writes (shared with the ISR)
+struct eewrite {
+	uint16_t addr;
+	const uint8_t *src;
+	uint16_t len;
+};
+
+static struct eewrite EeQueue[EEQ_SIZE];
+static volatile uint8_t EeQHead, EeQTail;	// the ISR works on EeQueue[EeQTail]
+
+// the record
+static uint8_t NvBuf[1 + NV_MAXDATA + 1];	// the slot being written (or read, by nvload)
+static uint8_t NvSize;						// record size (0 until nvload or nvsave)
+static uint8_t NvSlot;						// newest slot
+static uint8_t NvSeq;						// its sequence number
+
+
+//
+// CRC-8 (polynomial x^8 + x^2 + x + 1, 0x07), one byte at a time - a nibble at a time, from
+//	a 16 entry table (about 4 times quicker than bit by bit - the link checks every byte
+//	it receives)
+//
+static const uint8_t Crc8Tab[16] PROGMEM = {
+	0x00, 0x07, 0x0e, 0x09, 0x1c, 0x1b, 0x12, 0x15,
+	0x38, 0x3f, 0x36, 0x31, 0x24, 0x23, 0x2a, 0x2d
+};
+
+uint8_t _crc8(uint8_t crc, uint8_t b)
+{
+	crc ^= b;
+	crc = (crc << 4) ^ pgm_read_byte(&Crc8Tab[crc >> 4]);
+	crc = (crc << 4) ^ pgm_read_byte(&Crc8Tab[crc >> 4]);
+	return crc;
+}
+
+
+//
+// queue a write of len bytes from src to EEPROM address addr.  src must not change until
+//	it's written (see _eebusy).  returns 0 if the queue is full.
+//
+uint8_t _eequeue(uint16_t addr, const void *src, uint16_t len)
+{
+	uint8_t sreg, head;
+
+	sreg = SREG;
+	cli();
+
+	head = (EeQHead + 1) & (EEQ_SIZE-1);
+	if (head == EeQTail) {
+		SREG = sreg;
+		return 0;
+	}
+	EeQueue[EeQHead].addr = addr;
+	EeQueue[EeQHead].src = src;
+	EeQueue[EeQHead].len = len;
+	EeQHead = head;
+
+	EECR |= _BV(EERIE);			// (the interrupt comes as soon as the EEPROM is ready)
+
+	SREG = sreg;
+	return 1;
+}
+
+
+//
+// returns 1 if there are writes that haven't finished
+//
+uint8_t _eebusy(void)
+{
+	return (EeQHead != EeQTail) || (EECR & _BV(EEPE));
+}
+
+
+//
+// EEPROM is ready: start writing the next byte that needs it
+//
+ISR(EE_READY_vect)
+{
+	struct eewrite *w;
+	uint8_t b;
+
+	while (EeQHead != EeQTail) {
+		w = &EeQueue[EeQTail];
+		while (w->len != 0) {
+			b = *w->src++;
+			w->len--;
+			if (eeprom_read_byte((const uint8_t *)(uintptr_t)w->addr) != b) {
+				EEAR = w->addr++;
+				EEDR = b;
+				EECR |= _BV(EEMPE);		// (timed sequence: EEPE must be set within 4 cycles)
+				EECR |= _BV(EEPE);
+				return;
+			}
+			w->addr++;
+		}
+		EeQTail = (EeQTail + 1) & (EEQ_SIZE-1);
+	}
+	EECR &= ~_BV(EERIE);		// all done
+}
+
+
+//
+// returns 1 if a queued write is still reading from buf (n bytes)
+//
+uint8_t _eequeued(const void *buf, uint16_t n)
+{
+	uint8_t sreg, i, q = 0;
+
+	sreg = SREG;
+	cli();
+	for (i = EeQTail; i != EeQHead; i = (i + 1) & (EEQ_SIZE-1)) {
+		if (EeQueue[i].src >= (const uint8_t *)buf && EeQueue[i].src < (const uint8_t *)buf + n) {
+			q = 1;
+		}
+	}
+	SREG = sreg;
+	return q;
+}
+
+
+// EEPROM address of slot i
+static inline uint16_t slotaddr(uint8_t i)
+{
+	return NV_EE_ADDR + (uint16_t)i * (NvSize + 2);
+}
+
+static inline uint8_t nslots(void)
+{
+	return NV_EE_SIZE / (NvSize + 2);
+}
+
+
+//
+// read the record (size bytes) into data.  returns 1 if there is one, 0 if not (e.g. the
+//	EEPROM is blank, or the record was saved with a different size).  data can be NULL, to
+//	just find the newest slot (for nvsave).
+//	(size is at most NV_MAXDATA, and must be the same every time - it sets the layout.)
+//
+uint8_t nvload(void *data, uint8_t size)
+{
+	uint8_t i, j, crc, seq, found;
+	uint8_t *slot = NvBuf;		// (it's free - nothing is being written)
+
+	if (size == 0 || size > NV_MAXDATA) {		// error check
+		return 0;
+	}
+	while (_eebusy()) {
+		_idle();			// (reads can't happen in the middle of a write)
+	}
+	NvSize = size;
+
+	found = 0;
+	for (i = 0; i < nslots(); i++) {
+		eeprom_read_block(slot, (const void *)(uintptr_t)slotaddr(i), size + 2);
+		crc = 0;
+		for (j = 0; j < size + 1; j++) {
+			crc = _crc8(crc, slot[j]);
+		}
+		if (crc != slot[size + 1]) {
+			continue;
+		}
+		seq = slot[0];
+		if (!found || (int8_t)(seq - NvSeq) > 0) {	// (newer, allowing for wrap around)
+			found = 1;
+			NvSlot = i;
+			NvSeq = seq;
+			if (data != NULL) {
+				memcpy(data, &slot[1], size);
+			}
+		}
+	}
+
+	if (!found) {
+		NvSlot = nslots() - 1;		// so the first save goes in slot 0
+		NvSeq = 0;
+	}
+	return found;
+}
+
+
+//
+// save the record (size bytes) - it's copied, and written in the background.
+//	returns 0 if the last save is still being written (try again later).
+//	(other writes - e.g. savesession's - can still be going on.)
+//
+uint8_t nvsave(const void *data, uint8_t size)
+{
+	uint8_t i, crc;
+
+	if (size == 0 || size > NV_MAXDATA) {		// error check
+		return 0;
+	}
+	if (_eequeued(NvBuf, sizeof(NvBuf))) {
+		return 0;
+	}
+	if (NvSize != size) {
+		if (_eebusy()) {
+			return 0;		// (nvload would have to wait)
+		}
+		nvload(NULL, size);		// find the newest slot
+	}
+
+	NvSlot = (NvSlot + 1) % nslots();
+	NvSeq++;
+	NvBuf[0] = NvSeq;
+	memcpy(&NvBuf[1], data, size);
+	crc = 0;
+	for (i = 0; i < size + 1; i++) {
+		crc = _crc8(crc, NvBuf[i]);
+	}
+	NvBuf[size + 1] = crc;
+
+	return _eequeue(slotaddr(NvSlot), NvBuf, size + 2);
+}
+
+
+//
+// returns 1 while EEPROM writes (nvsave, savesession) are still going on
+//
+uint8_t nvbusy(void)
+{
+	return _eebusy();
+}
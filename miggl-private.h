@@ -11,6 +11,67 @@
  *
  *	revision history:
  *
+ *	- oct 18, 2026 - jesse
+ *		add _RowPinsHeld.
+ *
+ *	- oct 18, 2026 - jesse
+ *		the session defs are only there with MIGGL_SESSION (without it, do_session_isr(),
+ *		_sessionevent() and _Replaying are stand-ins that do nothing).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add TICK_US.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add _linkpoll() (miggl-link.c).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add _swapbegin() and _swapdone() (the two halves of swapbuffers, for miggl-run.c).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add _mstick() and do_timer_isr() (miggl-timer.c).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add do_link_isr() (miggl-link.c).
+ *
+ *	- oct 18, 2026 - jesse
+ *		TEMPOCONST, NOTE_SEP, ROW_TICKS and MS_TICKS come from TICKHZ (miggl.h).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add EEPROM write queue (_eequeue, _eequeued, _eebusy), _crc8() and NV_EE_ADDR (miggl-nv.c).
+ *
+ *	- oct 18, 2026 - jesse
+ *		durations are the duration value times DurUnit (set by settempo) - DurTab is gone.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add _finetick() and _seedpress() (miggl-seed.c).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add session defs (miggl-session.c): SES_EE_ADDR, _btninject(), do_session_isr(), etc.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add gesture timing (GEST_LONG_MS, etc).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add BTN_LOCKOUT_MS and _idle().
+ *
+ *	- oct 18, 2026 - jesse
+ *		add DEBOUNCE_MS and BTNQ_SIZE.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add pgm_read_row().  _shiftcolumn() takes a dispcol_t.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add MS_TICKS.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add ROW_TICKS, COL_GREEN and COL_RED (display scan).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add _shiftcolumn().
+ *
+ *	- oct 18, 2026 - jesse
+ *		add do_text_isr().
+ *
  *	- may 24, 2008 - rolf
  *		move MIN_NOTE constant to miggl.h.
  *
@@ -36,13 +97,19 @@
 // this is the size of all wave tables (in bytes) - seriously, don't change this!
 #define WTABSIZE 32
 
-#define TEMPOCONST 		1200000						// 20,000Hz * 60 sec
+#if TICKHZ % 1000 != 0 || TICKHZ > 20000
+#error "TICKHZ must be a multiple of 1000, up to 20000"
+#endif
+
+#define TEMPOCONST 		(TICKHZ * 60UL)				// 20,000Hz * 60 sec
 
-#define DEFAULTTEMPO	120.0						// default tempo in BPM (usually 75.0)
+#define DEFAULTTEMPO	120							// default tempo in BPM (usually 75.0)
 
-#define TEMPOBEAT		(TEMPOCONST/DEFAULTTEMPO)	// calculates duration value for a quarter note (1 beat)
+#define MINTEMPO		74							// slowest tempo: a whole note (48 units) must fit in 16 bits
 
-#define NOTE_SEP 200			// length of small pause at end of each note (to differentiate each new note)
+#define DURUNIT(bpm)	(TEMPOCONST/12/(bpm))		// ticks per duration unit (1/12 of a beat)
+
+#define NOTE_SEP (TICKHZ/100)	// length of small pause at end of each note (to differentiate each new note) - 10ms
 
 
 // fixed point number -- the integer part is as expected, the fractional part is a number divided by 256
@@ -54,7 +121,7 @@ struct fixedPtNum {
 
 // XXX fix.. these should be hidden (static) inside miggl.c
 extern uint16_t NoteTab[];
-extern uint16_t DurTab[];
+extern uint16_t DurUnit;
 
 
 //
@@ -67,5 +134,128 @@ extern uint16_t DurTab[];
 
 //
 // convert standard duration constants (e.g. N_QUARTER) into actual ticks used by audio code
+//	(any duration from 1 to 48 works, e.g. 4 is an 8th note triplet)
 //
-#define GETDURATION(dur)		(DurTab[dur-1])
+#define GETDURATION(dur)		((uint16_t)(dur) * DurUnit)
+
+
+/* private display-related defs */
+
+#define ROW_TICKS		(TICKHZ/1000)	// ISR ticks each display row (phase) stays on (20 ticks is about 1ms)
+
+#define MS_TICKS		(TICKHZ/1000)	// ISR ticks per millisecond (ISR runs at 20khz)
+#define TICK_US			(1000000UL/TICKHZ)	// microseconds per ISR tick (50 at 20khz)
+
+#define DEBOUNCE_MS		5			// milliseconds between button samples (a change must be seen 4 times)
+
+#define BTN_LOCKOUT_MS	20			// INPUT_PCINT: milliseconds to ignore a button after it changes
+
+#define BTNQ_SIZE		8			// button event queue entries (must be a power of 2)
+
+#define GESTQ_SIZE		4			// gesture events waiting for getbuttonevent (must be a power of 2)
+
+#define GEST_LONG_MS			800		// held this long is a long press (BE_LONG)
+#define GEST_REPEAT_DELAY_MS	400		// first BE_REPEAT comes this long after the press,
+#define GEST_REPEAT_MS			150		// then one every this long
+#define GEST_CHORD_MS			60		// presses this close together are a chord (BE_CHORD)
+
+#define COL_GREEN		0x1			// for columns_on()
+#define COL_RED			0x2
+
+extern uint8_t _RowPinsHeld;		// row pins DISP_WRITEROW leaves high (see iodefs.h)
+
+// read one display buffer row (e.g. from an animation keyframe) from program memory
+#if XSCREEN <= 8
+#define pgm_read_row(p)		pgm_read_byte(p)
+#else
+#define pgm_read_row(p)		pgm_read_word(p)
+#endif
+
+
+// idle the cpu until the next interrupt (used by the wait functions)
+void _idle(void);
+
+// the millisecond tick, as gettick32() (call with interrupts off)
+uint32_t _mstick(void);
+
+// swapbuffers(), without the wait: _swapbegin(), then _swapdone() until it returns 1
+void _swapbegin(void);
+uint8_t _swapdone(void);
+
+
+/* private graphics-related defs */
+
+// shift display left one column, new column gets bits in color c (see shift_in_column)
+void _shiftcolumn(dispcol_t bits, uint8_t c);
+
+
+/* private text-related defs */
+
+// text portion of the display ISR (in miggl-text.c), called once per frame
+void do_text_isr(void);
+
+
+/* private session-related defs (see miggl-session.c) */
+
+#define SES_EE_ADDR		256			// where savesession() keeps a recording in EEPROM (length, then data)
+#define SES_EE_SIZE		256			// (the upper half of the atmega88's 512 bytes)
+
+#ifdef MIGGL_SESSION
+extern volatile uint8_t _Replaying;	// 1 while a session is replaying
+
+// session portion of the display ISR (in miggl-session.c), called every millisecond
+void do_session_isr(void);
+
+// a debounced button event, for the session recorder (b is 0-3, type is BE_PRESS or BE_RELEASE)
+void _sessionevent(uint8_t b, uint8_t type);
+
+// press (down = 1) or release a button, as if it was real (in miggl.c)
+void _btninject(uint8_t b, uint8_t down);
+#else
+#define _Replaying				0
+#define do_session_isr()
+#define _sessionevent(b, type)
+#endif
+
+
+/* private seed-related defs (see miggl-seed.c) */
+
+// ISR ticks (1/TICKHZ s) since start_timer1() (in miggl.c) - wraps every 65536 ticks.  (call with interrupts off)
+uint16_t _finetick(void);
+
+// a button was pressed (called from btnchange, in the ISR)
+void _seedpress(void);
+
+
+/* private EEPROM-related defs (see miggl-nv.c) */
+
+#define NV_EE_ADDR		0			// where nvsave() keeps its log of records in EEPROM
+#define NV_EE_SIZE		256			// (the lower half - sessions have the upper half)
+
+// queue a write of len bytes from src (which must stay put until it's written) to EEPROM addr.
+//	returns 0 if the queue is full.
+uint8_t _eequeue(uint16_t addr, const void *src, uint16_t len);
+
+// 1 if a queued write is still reading from buf (n bytes)
+uint8_t _eequeued(const void *buf, uint16_t n);
+
+// 1 if EEPROM writes are queued or going on (EEPROM can't be read until they're done)
+uint8_t _eebusy(void);
+
+// add byte b to CRC-8 crc (start with 0)
+uint8_t _crc8(uint8_t crc, uint8_t b);
+
+
+/* private timer-related defs (see miggl-timer.c) */
+
+// timer portion of the display ISR (in miggl-timer.c), called every millisecond with the new tick
+void do_timer_isr(uint32_t now);
+
+
+/* private link-related defs (see miggl-link.c) */
+
+// link portion of the display ISR (in miggl-link.c), called every millisecond
+void do_link_isr(void);
+
+// finds the frames the ISR has received (in miggl-link.c) - called from the main loop
+void _linkpoll(void);
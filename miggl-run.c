@@ -0,0 +1,232 @@
+/*
+ *	miggl-run.c - Mignonette Game Library - start up, and the main loop
+ *
+ *	author(s): jesse fulton (jesse.fulton at gmail dot com) (c) 2010 - Some Rights Reserved
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ *
+ *
+ *	miggl_init() does the start up every game needs, in the right order.  then the game
+ *	says what to call - once a frame (miggl_onframe), for each button event (miggl_onbutton),
+ *	and when a software timer goes off (miggl_ontimer) - and miggl_run() calls them, one at
+ *	a time, each one to the end (nothing is interrupted but by the ISR, so the callbacks don't
+ *	have to worry about each other).
+ *
+ *	the frame callback runs right after each swap (like a loop around swapbuffers()).  while
+ *	the frame is waiting to be swapped, button and timer callbacks still run - and when there's
+ *	nothing to do at all, the CPU idles until the next interrupt.
+ *
+ *	button events with no miggl_onbutton callback stay queued, for getbuttonevent().  (the
+ *	same for timers, and timerexpired.)
+ *
+ *	with -DMIGGL_TASKSTATS, each task's runs and run time are counted (gettaskstats).  the time waiting (idle) is
+ *	counted as TASK_IDLE, so e.g. its share of the total is how much of the CPU is free.
+ *	times are in ISR ticks (1/TICKHZ s), so a run longer than 65536 ticks (3.2 seconds at
+ *	20khz) isn't counted right.
+ *
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		the task statistics are only kept with MIGGL_TASKSTATS (they take 70 bytes of RAM).
+ *
+ *	- oct 18, 2026 - jesse
+ *		call _linkpoll() every time around the loop.
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.
+ *
+ *
+ */
+
+#include <inttypes.h>
+#include <avr/io.h>			/* this takes care of definitions for our specific AVR */
+#include <avr/interrupt.h>	/* for cli(), etc */
+#include <stdio.h>			// for NULL, FILE (miggl.h)
+#include <string.h>			// for memset
+
+#include "mydefs.h"
+
+#include "miggl.h"
+#include "miggl-private.h"
+
+
+static void (*FrameFn)(void);
+static void (*ButtonFn)(struct buttonevent *ev);
+static void (*TimerFn[MAXTIMERS])(void);
+
+#ifdef MIGGL_TASKSTATS
+static struct taskstats TaskStats[NTASKS];
+#endif
+
+
+//
+// start up: the I/O pins, the display, the ISR, the random seed, the buttons and audio.
+//	(the default input mode and swap interval can be changed after.)
+//
+void miggl_init(void)
+{
+	avrinit();
+	initswapbuffers();
+	cleardisplay();
+	start_timer1();			// this starts display refresh and audio processing
+	seedinit();				// start collecting entropy for the random seed
+	button_init();
+	initaudio();
+#ifdef MIGGL_TASKSTATS
+	resettaskstats();
+#endif
+}
+
+
+//
+// what miggl_run() calls (NULL for nothing):
+//	miggl_onframe - once a frame, after swapbuffers (see swapinterval)
+//	miggl_onbutton - for each button event (see getbuttonevent)
+//	miggl_ontimer - when software timer n goes off (once for each time - see starttimer)
+//
+void miggl_onframe(void (*fn)(void))
+{
+	FrameFn = fn;
+}
+
+void miggl_onbutton(void (*fn)(struct buttonevent *ev))
+{
+	ButtonFn = fn;
+}
+
+void miggl_ontimer(uint8_t n, void (*fn)(void))
+{
+	if (n < MAXTIMERS) {		// error check
+		TimerFn[n] = fn;
+	}
+}
+
+
+#ifdef MIGGL_TASKSTATS
+// the ISR tick (see _finetick)
+static uint16_t finenow(void)
+{
+	uint8_t sreg;
+	uint16_t t;
+
+	sreg = SREG;
+	cli();
+	t = _finetick();
+	SREG = sreg;
+
+	return t;
+}
+
+// count a run of task, which started at ISR tick t0
+static void counttask(uint8_t task, uint16_t t0)
+{
+	struct taskstats *ts;
+	uint16_t t;
+
+	t = finenow() - t0;
+	ts = &TaskStats[task];
+	ts->runs++;
+	ts->sum += t;
+	if (t > ts->max) {
+		ts->max = t;
+	}
+}
+#else
+// (nothing is counted - these compile to nothing)
+static inline uint16_t finenow(void)
+{
+	return 0;
+}
+
+static inline void counttask(uint8_t task, uint16_t t0)
+{
+}
+#endif
+
+
+//
+// the main loop - this never returns
+//
+void miggl_run(void)
+{
+	struct buttonevent ev;
+	uint8_t swapping, did, n, mask, count;
+	uint16_t t0;
+
+	swapping = 0;
+	for (;;) {
+		did = 0;
+
+		// what the link has received (see miggl-link.c)
+		_linkpoll();
+
+		// the frame: run it, then wait for the swap (doing anything else there is meanwhile)
+		if (swapping && _swapdone()) {
+			swapping = 0;
+		}
+		if (FrameFn != NULL && !swapping) {
+			t0 = finenow();
+			FrameFn();
+			counttask(TASK_FRAME, t0);
+			_swapbegin();
+			swapping = 1;
+			did = 1;
+		}
+
+		// a button event (one at a time, so a burst of them doesn't hold up the frame)
+		if (ButtonFn != NULL && getbuttonevent(&ev)) {
+			t0 = finenow();
+			ButtonFn(&ev);
+			counttask(TASK_BUTTON, t0);
+			did = 1;
+		}
+
+		// timers
+		mask = gettimers();
+		for (n = 0; mask != 0; n++, mask >>= 1) {
+			if ((mask & 1) && TimerFn[n] != NULL) {
+				count = timerexpired(n);
+				while (count-- != 0) {
+					t0 = finenow();
+					TimerFn[n]();
+					counttask(TASK_TIMER + n, t0);
+				}
+				did = 1;
+			}
+		}
+
+		// nothing to do: idle until the next interrupt
+		if (!did) {
+			t0 = finenow();
+			_idle();
+			counttask(TASK_IDLE, t0);
+		}
+	}
+}
+
+
+#ifdef MIGGL_TASKSTATS
+//
+// get the run statistics of task (TASK_FRAME, etc):
+//	runs - times it ran
+//	max - longest run, in ISR ticks (1/TICKHZ seconds)
+//	sum - all of its runs, in ISR ticks (the average is sum / runs)
+//
+void gettaskstats(uint8_t task, struct taskstats *ts)
+{
+	if (task < NTASKS) {		// error check
+		*ts = TaskStats[task];
+	}
+	else {
+		memset(ts, 0, sizeof(*ts));
+	}
+}
+
+void resettaskstats(void)
+{
+	memset(TaskStats, 0, sizeof(TaskStats));
+}
+#endif
@@ -0,0 +1,157 @@
+/*
+ *	miggl-seed.c - Mignonette Game Library - random seed from boot entropy
+ *
+ *	author(s): jesse fulton (jesse.fulton at gmail dot com) (c) 2010 - Some Rights Reserved
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ *
+ *
+ *	getseed() returns a 16 bit seed, mixed from:
+ *		- uninitialised SRAM (SeedRam, in .noinit), read once by seedinit().  after a power up
+ *			it's noisy; the pool is written back to it, so a reset doesn't repeat either.
+ *		- watchdog vs. main clock jitter: the watchdog runs from its own 128khz RC oscillator,
+ *			so where timer1 is when it fires drifts around.  seedinit() turns on the watchdog
+ *			interrupt (16ms) for SEED_WDT_SAMPLES samples, in the background.
+ *		- timer1 at every button press (see btnchange in miggl.c) - a person can't press a
+ *			button to the microsecond.
+ *
+ *	seedinit() only reads a few bytes of RAM and starts the watchdog, so it costs tens of
+ *	microseconds at boot (see getseedcost).  the watchdog samples are all in 128ms later.
+ *
+ *	note: this needs the WDTON fuse unprogrammed (the default), or the watchdog resets us.
+ *
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.  (replaces simone's init_random, which summed all of data space.)
+ *
+ *
+ */
+
+#include <inttypes.h>
+#include <avr/io.h>			/* this takes care of definitions for our specific AVR */
+#include <avr/interrupt.h>	/* for cli(), ISR, etc */
+#include <stdio.h>			// for NULL, FILE (miggl.h)
+
+#include "mydefs.h"
+
+#include "miggl.h"
+#include "miggl-private.h"
+
+
+#define SEED_RAM_SIZE		16		// bytes of uninitialised SRAM to hash
+#define SEED_WDT_SAMPLES	8		// watchdog samples to take (16ms each)
+
+
+static uint8_t SeedRam[SEED_RAM_SIZE] __attribute__((section(".noinit")));
+
+static volatile uint16_t Seed;			// the pool
+static volatile uint8_t SeedWdt;		// watchdog samples left to take
+static uint16_t SeedCost;				// seedinit() time, in microseconds
+
+
+//
+// mix x into the pool (xorshift16 step, so every bit of x reaches every bit of the pool).
+//	(call with interrupts off)
+//
+static void seedmix(uint16_t x)
+{
+	uint16_t s;
+
+	s = Seed ^ x;
+	s ^= s << 7;
+	s ^= s >> 9;
+	s ^= s << 8;
+	Seed = s;
+}
+
+
+//
+// time now, in microseconds (wraps).  (call with interrupts off)
+//
+static uint16_t nowus(void)
+{
+	return _finetick() * TICK_US + TCNT1;		// (timer1 counts microseconds: 8mhz / 8)
+}
+
+
+//
+// start collecting entropy - call once at boot, after start_timer1().
+//
+void seedinit(void)
+{
+	uint8_t sreg, i;
+	uint16_t t;
+
+	sreg = SREG;
+	cli();
+
+	t = nowus();
+
+	// uninitialised SRAM
+	for (i = 0; i < SEED_RAM_SIZE; i += 2) {
+		seedmix(((uint16_t)SeedRam[i] << 8) | SeedRam[i+1]);
+	}
+	SeedRam[0] ^= Seed >> 8;		// so the next reset (which keeps SRAM) starts somewhere else
+	SeedRam[1] ^= Seed & 0xff;
+
+	// watchdog interrupt, every 16ms (no reset)
+	SeedWdt = SEED_WDT_SAMPLES;
+	MCUSR &= ~_BV(WDRF);
+	WDTCSR = _BV(WDCE) | _BV(WDE);		// (timed sequence: the next write must be within 4 cycles)
+	WDTCSR = _BV(WDIE);
+
+	SeedCost = nowus() - t;
+
+	SREG = sreg;
+}
+
+
+ISR(WDT_vect)
+{
+	seedmix(((uint16_t)TCNT1 << 8) ^ _finetick());
+
+	if (--SeedWdt == 0) {
+		WDTCSR = _BV(WDCE) | _BV(WDE);		// watchdog off
+		WDTCSR = 0;
+	}
+}
+
+
+//
+// a button was pressed (called by miggl.c, from an ISR)
+//
+void _seedpress(void)
+{
+	seedmix(((uint16_t)TCNT1 << 8) ^ _finetick());
+}
+
+
+//
+// returns the seed - it's never 0.
+//	(it changes with every button press, and for the first 128ms after seedinit.)
+//
+uint16_t getseed(void)
+{
+	uint8_t sreg;
+	uint16_t s;
+
+	sreg = SREG;
+	cli();
+	s = Seed;
+	SREG = sreg;
+
+	return (s != 0) ? s : 1;
+}
+
+
+//
+// returns how long seedinit() took, in microseconds
+//
+uint16_t getseedcost(void)
+{
+	return SeedCost;
+}
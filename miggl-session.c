@@ -0,0 +1,298 @@
+/*
+ *	miggl-session.c - Mignonette Game Library - record and replay of button sessions
+ *
+ *	author(s): jesse fulton (jesse.fulton at gmail dot com) (c) 2010 - Some Rights Reserved
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ *
+ *
+ *	a session is one game, from startsession() to endsession().  while recording, every
+ *	(debounced) button press and release goes into a buffer with its time, along with the
+ *	random seed the game started with.  replaying feeds the events back in at the same times,
+ *	as if the buttons were pressed (the real buttons are ignored until the replay is over),
+ *	and hands the game the same seed - so the game does exactly the same thing again.
+ *
+ *	recording format (the buffer is the caller's, in RAM):
+ *		2 bytes - the seed (high byte first)
+ *		then 2 bytes per entry: the top 4 bits are a code, the other 12 bits are the time
+ *		since the previous entry, in milliseconds (high byte first).
+ *			code 0 to 7 - button event: (button number << 1) | 1 for a press, 0 for a release
+ *			SES_WAIT - no event (time passes - used for gaps of 4096ms and over)
+ *			SES_END - end of the recording
+ *
+ *	a recording can be kept in EEPROM with savesession(), and read back with loadsession().
+ *	(savesession doesn't wait - the bytes are written in the background, see miggl-nv.c.)
+ *
+ *	all this is only built with -DMIGGL_SESSION (the buffer and state take RAM that a game
+ *	may not have to spare).  without it, the functions are stand-ins (see miggl.h).
+ *
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		only built with MIGGL_SESSION.
+ *
+ *	- oct 18, 2026 - jesse
+ *		savesession() always ends the session, and returns whether it could save it.
+ *		startsession() ends a session that's still running first, and setsession() keeps
+ *		its buffer aside until then (so it can be called while one is running).
+ *
+ *	- oct 18, 2026 - jesse
+ *		savesession() doesn't wait for the EEPROM writes (they're queued, see miggl-nv.c).
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.
+ *
+ *
+ */
+
+#include <inttypes.h>
+#include <avr/io.h>			/* this takes care of definitions for our specific AVR */
+#include <avr/interrupt.h>	/* for cli(), etc */
+#include <avr/eeprom.h>		/* for eeprom_read_block(), etc */
+#include <stdio.h>			// for NULL, FILE (miggl.h)
+
+#include "mydefs.h"
+
+#include "miggl.h"
+#include "miggl-private.h"
+
+#ifdef MIGGL_SESSION
+
+#define SES_WAIT		8			// entry codes (see above)
+#define SES_END			15
+
+#define SES_MAXDELTA	0xfff		// largest time in one entry (ms)
+
+
+// session state (shared with the ISR)
+
+static uint8_t SesArmed = SES_OFF;		// what startsession() will do
+static uint8_t *SesArmBuf;				// and its buffer (and size)
+static uint16_t SesArmSize;
+static volatile uint8_t SesMode = SES_OFF;	// what we're doing now
+volatile uint8_t _Replaying;			// 1 while replaying (miggl.c ignores the real buttons)
+
+static uint8_t *SesBuf;
+static uint16_t SesSize;				// size of SesBuf (record) or of the recording (replay)
+static uint16_t SesLen;					// bytes recorded / replayed so far
+static uint16_t SesDelta;				// ms since the last entry (record), or until the next (replay)
+
+
+//
+// set up what the next startsession() does:
+//	SES_RECORD - record into buf (size bytes).
+//	SES_REPLAY - replay the recording in buf (size bytes, e.g. from loadsession).
+//	SES_OFF - nothing.
+//	(a session that's running isn't affected - this is for the next one.)
+//
+void setsession(uint8_t mode, uint8_t *buf, uint16_t size)
+{
+	if (buf == NULL || size < 4) {		// error check (room for the seed and the end)
+		mode = SES_OFF;
+	}
+	SesArmed = mode;
+	SesArmBuf = buf;
+	SesArmSize = size;
+}
+
+
+//
+// returns SES_RECORD or SES_REPLAY while a session is running, or if one is set up
+//	for the next startsession().  otherwise, SES_OFF.
+//
+uint8_t getsession(void)
+{
+	return (SesMode != SES_OFF) ? SesMode : SesArmed;
+}
+
+
+// read the entry at SesLen (replay)
+static inline uint16_t readentry(void)
+{
+	if (SesLen + 2 > SesSize) {
+		return (uint16_t)SES_END << 12;
+	}
+	return ((uint16_t)SesBuf[SesLen] << 8) | SesBuf[SesLen+1];
+}
+
+
+// add an entry (record).  two bytes are always kept free for the end.
+static void writeentry(uint8_t code, uint16_t delta)
+{
+	if (SesLen + 4 > SesSize) {
+		return;			// full - the rest of the session isn't recorded
+	}
+	SesBuf[SesLen++] = (code << 4) | (delta >> 8);
+	SesBuf[SesLen++] = delta & 0xff;
+	SesDelta = 0;
+}
+
+
+//
+// start a session (e.g. when a new game starts), with the random seed the game would use.
+//	returns the seed the game should use - for a replay, that's the recorded one.
+//	if a session is still running, it's ended first (see endsession).
+//
+uint16_t startsession(uint16_t seed)
+{
+	uint8_t sreg;
+
+	if (SesMode != SES_OFF) {
+		endsession();
+	}
+	if (SesArmed == SES_RECORD) {
+		while (_eebusy()) {
+			_idle();		// savesession is still writing the buffer out (it takes a second or so)
+		}
+	}
+
+	sreg = SREG;
+	cli();
+
+	SesBuf = SesArmBuf;
+	SesSize = SesArmSize;
+	SesLen = 2;
+	SesDelta = 0;
+	SesMode = SesArmed;
+	SesArmed = SES_OFF;
+
+	if (SesMode == SES_RECORD) {
+		SesBuf[0] = seed >> 8;
+		SesBuf[1] = seed & 0xff;
+	} else if (SesMode == SES_REPLAY) {
+		seed = ((uint16_t)SesBuf[0] << 8) | SesBuf[1];
+		SesDelta = readentry() & SES_MAXDELTA;
+		_Replaying = 1;
+	}
+
+	SREG = sreg;
+	return seed;
+}
+
+
+//
+// end the session.  returns the length of the recording (in bytes) if we were recording -
+//	the recording is then in the buffer given to setsession().  otherwise, returns 0.
+//	(if the session has already ended, this returns the same thing again.)
+//
+uint16_t endsession(void)
+{
+	uint8_t sreg;
+	static uint16_t lastlen;
+
+	sreg = SREG;
+	cli();
+
+	if (SesMode == SES_RECORD) {
+		SesBuf[SesLen++] = SES_END << 4;
+		SesBuf[SesLen++] = 0;
+		lastlen = SesLen;
+	} else if (SesMode == SES_REPLAY) {
+		lastlen = 0;
+	}
+	SesMode = SES_OFF;
+	_Replaying = 0;
+
+	SREG = sreg;
+	return lastlen;
+}
+
+
+//
+// a debounced button event (called by miggl.c, from an ISR).  b is the button number (0-3).
+//
+void _sessionevent(uint8_t b, uint8_t type)
+{
+	if (SesMode == SES_RECORD) {
+		writeentry((b << 1) | (type == BE_PRESS), SesDelta);
+	}
+}
+
+
+//
+// session portion of the ISR - called every millisecond.
+//
+void do_session_isr(void)
+{
+	uint16_t e;
+	uint8_t code;
+
+	if (SesMode == SES_RECORD) {
+		if (++SesDelta == SES_MAXDELTA) {
+			writeentry(SES_WAIT, SES_MAXDELTA);
+		}
+	} else if (SesMode == SES_REPLAY) {
+		if (SesDelta != 0 && --SesDelta != 0) {
+			return;
+		}
+
+		// play every entry that is due now
+		do {
+			e = readentry();
+			code = e >> 12;
+
+			if (code == SES_END) {
+				SesMode = SES_OFF;		// done - the real buttons work again
+				_Replaying = 0;
+				return;
+			}
+			if (code < SES_WAIT) {
+				_btninject(BTN_A << (code >> 1), code & 1);
+			}
+
+			SesLen += 2;
+			SesDelta = readentry() & SES_MAXDELTA;
+		} while (SesDelta == 0);
+	}
+}
+
+
+//
+// end the session (see endsession), and save its recording to EEPROM.
+//	this returns straight away - the writes take a few ms per byte that changed, and
+//	happen in the background (nvbusy() says when they're done).  the buffer mustn't
+//	change until then (the next recording's startsession waits for them).
+//	returns 1 if the recording is being saved.  0 if there isn't one (it wasn't recording,
+//	or it's too long for SES_EE_SIZE), or if the last one is still being saved - then the
+//	session is still ended, so calling this again (once nvbusy() is 0) saves it.
+//
+uint8_t savesession(void)
+{
+	static uint16_t len;		// (written out after we return)
+	uint16_t n;
+
+	n = endsession();
+	if (n == 0 || n > SES_EE_SIZE - 2) {
+		return 0;
+	}
+	if (_eequeued(&len, 2) || _eequeued(SesBuf, SesSize)) {
+		return 0;			// (still saving the last one)
+	}
+	len = n;
+	return _eequeue(SES_EE_ADDR, &len, 2) && _eequeue(SES_EE_ADDR + 2, SesBuf, len);
+}
+
+
+//
+// read a recording from EEPROM into buf (size bytes).
+//	returns its length, or 0 if there isn't one (or it doesn't fit).
+//
+uint16_t loadsession(uint8_t *buf, uint16_t size)
+{
+	uint16_t len;
+
+	while (_eebusy()) {
+		_idle();			// (reads can't happen in the middle of a write)
+	}
+	eeprom_read_block(&len, (const void *)SES_EE_ADDR, 2);
+	if (len < 4 || len > size || len > SES_EE_SIZE - 2) {		// (erased EEPROM is 0xffff)
+		return 0;
+	}
+	eeprom_read_block(buf, (const void *)(SES_EE_ADDR + 2), len);
+	return len;
+}
+
+#endif
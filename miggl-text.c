@@ -0,0 +1,314 @@
+/*
+ *	miggl-text.c - Mignonette Game Library - 3x5 font and scrolling text
+ *
+ *	author(s): jesse fulton (jesse.fulton at gmail dot com) (c) 2010 - Some Rights Reserved
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ *
+ *
+ *	the font covers digits, letters (lowercase is shown as uppercase) and a little punctuation.
+ *	each glyph is 3 columns by 5 pixels, packed into one 16-bit word in program memory.
+ *
+ *	scrolling text works like playsong(): scrolltext() just sets things up, and the display
+ *	ISR shifts one new column into the right edge of the display every few frames.
+ *	so, the caller is never blocked (unless it chooses to call waittext).
+ *
+ *	note: don't draw on the display while text is scrolling - the ISR owns it until
+ *		istextscrolling() returns 0.
+ *
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		waittext() idles the cpu instead of spinning.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add FONT_HEIGHT, so drawchar() doesn't depend on the display size.
+ *
+ *	- oct 18, 2026 - jesse
+ *		use _shiftcolumn() from miggl.c.
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.
+ *
+ *
+ */
+
+#include <inttypes.h>
+#include <avr/io.h>			/* this takes care of definitions for our specific AVR */
+#include <avr/pgmspace.h>	/* for PROGMEM, pgm_read_word, etc */
+#include <stdio.h>			// for NULL, FILE (miggl.h)
+
+#include "mydefs.h"
+
+#include "miggl.h"
+#include "miggl-private.h"
+
+
+//
+// glyph rows are written as 3-bit numbers (4 = left pixel, 2 = middle, 1 = right), top row first.
+// GLYPH() turns those into 3 columns of 5 bits: column 0 in bits 0-4, column 1 in bits 5-9 and
+// column 2 in bits 10-14.  within a column, bit 0 is the top pixel.
+//
+#define FROW(r, y)		( ((((r) >> 2) & 1) << (y)) | ((((r) >> 1) & 1) << ((y)+5)) | (((r) & 1) << ((y)+10)) )
+
+#define GLYPH(r0, r1, r2, r3, r4)	\
+	(uint16_t)(FROW(r0,0) | FROW(r1,1) | FROW(r2,2) | FROW(r3,3) | FROW(r4,4))
+
+#define FONT_WIDTH		3		// columns per glyph (a blank column is added between glyphs)
+#define FONT_HEIGHT		5		// pixels per column
+#define FONT_DIGITS		0		// index of '0' in FontTab
+#define FONT_LETTERS	10		// index of 'A' in FontTab
+#define FONT_PUNCT		36		// index of first entry in FontPunct (space)
+
+
+static const uint16_t FontTab[] PROGMEM = {
+	GLYPH(7,5,5,5,7),	// 0
+	GLYPH(2,2,2,2,2),	// 1
+	GLYPH(7,1,7,4,7),	// 2
+	GLYPH(7,1,7,1,7),	// 3
+	GLYPH(5,5,7,1,1),	// 4
+	GLYPH(7,4,7,1,7),	// 5
+	GLYPH(4,4,7,5,7),	// 6
+	GLYPH(7,1,1,1,1),	// 7
+	GLYPH(7,5,7,5,7),	// 8
+	GLYPH(7,5,7,1,1),	// 9
+
+	GLYPH(2,5,7,5,5),	// A
+	GLYPH(6,5,6,5,6),	// B
+	GLYPH(3,4,4,4,3),	// C
+	GLYPH(6,5,5,5,6),	// D
+	GLYPH(7,4,6,4,7),	// E
+	GLYPH(7,4,6,4,4),	// F
+	GLYPH(3,4,5,5,3),	// G
+	GLYPH(5,5,7,5,5),	// H
+	GLYPH(7,2,2,2,7),	// I
+	GLYPH(1,1,1,5,2),	// J
+	GLYPH(5,5,6,5,5),	// K
+	GLYPH(4,4,4,4,7),	// L
+	GLYPH(5,7,7,5,5),	// M
+	GLYPH(6,5,5,5,5),	// N
+	GLYPH(2,5,5,5,2),	// O
+	GLYPH(6,5,6,4,4),	// P
+	GLYPH(2,5,5,6,3),	// Q
+	GLYPH(6,5,6,5,5),	// R
+	GLYPH(3,4,2,1,6),	// S
+	GLYPH(7,2,2,2,2),	// T
+	GLYPH(5,5,5,5,7),	// U
+	GLYPH(5,5,5,5,2),	// V
+	GLYPH(5,5,7,7,5),	// W
+	GLYPH(5,5,2,5,5),	// X
+	GLYPH(5,5,2,2,2),	// Y
+	GLYPH(7,1,2,4,7),	// Z
+
+	GLYPH(0,0,0,0,0),	// (space)
+	GLYPH(0,0,7,0,0),	// -
+	GLYPH(2,2,2,0,2),	// !
+	GLYPH(0,0,0,0,2),	// .
+	GLYPH(0,2,0,2,0),	// :
+	GLYPH(6,1,2,0,2),	// ?
+};
+
+// punctuation characters, in the same order as the end of FontTab
+static const char FontPunct[] PROGMEM = " -!.:?";
+
+
+// scrolling text state (shared with the ISR)
+
+static volatile uint8_t TextPlayFlag;	// 1 while text is scrolling
+
+static const char *TextPtr;			// next character to scroll in
+static uint8_t TextInPgm;			// 1 if TextPtr points into program memory
+static uint16_t TextGlyph;			// remaining columns of the current glyph
+static uint8_t TextCol;				// columns left to shift in for the current glyph
+static uint8_t TextTail;			// blank columns left to shift in after the last glyph
+static uint8_t TextColor;
+static uint8_t TextSpeed = 1;		// frames per column
+static uint8_t TextCount;
+
+static char TextNum[6];				// buffer for scrollnumber() (up to 65535)
+
+
+//
+// look up the packed glyph for character c.
+// unknown characters are drawn as a space.
+//
+static uint16_t fontglyph(char c)
+{
+	uint8_t i;
+	char p;
+
+	if (c >= 'a' && c <= 'z') {
+		c -= 'a' - 'A';
+	}
+
+	if (c >= '0' && c <= '9') {
+		i = FONT_DIGITS + (c - '0');
+	} else if (c >= 'A' && c <= 'Z') {
+		i = FONT_LETTERS + (c - 'A');
+	} else {
+		i = FONT_PUNCT;
+		while ((p = pgm_read_byte(&FontPunct[i - FONT_PUNCT])) != '\0') {
+			if (p == c) {
+				break;
+			}
+			i++;
+		}
+		if (p == '\0') {
+			i = FONT_PUNCT;		// not found, use space
+		}
+	}
+
+	return pgm_read_word(&FontTab[i]);
+}
+
+
+//
+// text portion of the display ISR - called once per frame (see swapinterval).
+//
+void do_text_isr(void)
+{
+	char c;
+
+	if (!TextPlayFlag) {
+		return;
+	}
+	if (--TextCount != 0) {
+		return;
+	}
+	TextCount = TextSpeed;
+
+	if (TextCol == 0) {
+		c = TextInPgm ? pgm_read_byte(TextPtr) : *TextPtr;
+
+		if (c != '\0') {
+			TextPtr++;
+			TextGlyph = fontglyph(c);
+			TextCol = FONT_WIDTH + 1;		// glyph, plus one blank column
+		} else if (TextTail != 0) {
+			TextTail--;						// keep going until the last glyph has left the screen
+			TextGlyph = 0;
+			TextCol = 1;
+		} else {
+			TextPlayFlag = 0;				// all done
+			return;
+		}
+	}
+
+	_shiftcolumn(TextGlyph & ((1 << FONT_HEIGHT) - 1), TextColor);
+	TextGlyph >>= FONT_HEIGHT;
+	TextCol--;
+}
+
+
+static void starttext(const char *s, uint8_t inpgm)
+{
+	if (s == NULL) {		// error check
+		return;
+	}
+
+	TextPlayFlag = 0;		// just in case text is currently scrolling
+
+	TextPtr = s;
+	TextInPgm = inpgm;
+	TextCol = 0;
+	TextTail = XSCREEN - 1;	// (the blank column after the last glyph makes up the difference)
+	TextColor = getcolor();
+	TextCount = 1;			// first column appears on the next frame
+
+	TextPlayFlag = 1;
+}
+
+
+//
+// scroll a string across the display, right to left, in the current color.
+// the string is not copied, so it must stay around until scrolling is finished.
+//
+void scrolltext(const char *s)
+{
+	starttext(s, 0);
+}
+
+
+//
+// same as scrolltext(), but the string is in program memory (e.g. PSTR("GAME OVER"))
+//
+void scrolltext_P(const char *s)
+{
+	starttext(s, 1);
+}
+
+
+//
+// scroll a number across the display, in the current color.
+//
+void scrollnumber(uint16_t n)
+{
+	char *p;
+
+	TextPlayFlag = 0;		// we are about to overwrite TextNum
+
+	p = &TextNum[sizeof(TextNum) - 1];
+	*p = '\0';
+	do {
+		*--p = '0' + (n % 10);
+		n /= 10;
+	} while (n != 0);
+
+	starttext(p, 0);
+}
+
+
+//
+// set the scrolling speed, in frames per column (default is 1).
+//
+void settextspeed(uint8_t frames)
+{
+	if (frames != 0) {
+		TextSpeed = frames;
+	}
+}
+
+
+//
+// this returns 1 if text is scrolling, 0 otherwise.
+//
+uint8_t istextscrolling(void)
+{
+	return TextPlayFlag;
+}
+
+
+//
+// this waits until text has finished scrolling, then returns.
+//
+void waittext(void)
+{
+	while (TextPlayFlag) {
+		_idle();
+	}
+}
+
+
+//
+// draw character c with its left edge at column x, using the current color.
+// only the lit pixels of the glyph are drawn (like drawpoint).
+//
+void drawchar(uint8_t x, char c)
+{
+	uint16_t g;
+	uint8_t col, y;
+
+	g = fontglyph(c);
+
+	for (col = 0; col < FONT_WIDTH; col++) {
+		for (y = 0; y < FONT_HEIGHT; y++) {
+			if (g & 0x1) {
+				drawpoint(x + col, y);
+			}
+			g >>= 1;
+		}
+	}
+}
@@ -0,0 +1,235 @@
+/*
+ *	miggl-timer.c - Mignonette Game Library - software timers and delays
+ *
+ *	author(s): jesse fulton (jesse.fulton at gmail dot com) (c) 2010 - Some Rights Reserved
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ *
+ *
+ *	MAXTIMERS timers, numbered 0 to MAXTIMERS-1 (the program picks which is which).
+ *	starttimer() sets one to go off after some milliseconds - once, or every so often after
+ *	that (periodic).  the ISR counts how many times each one has gone off, and the program
+ *	picks that up when it likes (timerexpired), so nothing runs in the ISR but the count -
+ *	and a periodic timer doesn't drift, however late it's looked at.
+ *
+ *	times are against the millisecond tick (gettick32), which comes from the timer1 overflow,
+ *	so they're real elapsed time, whatever the main program is doing.  the ISR only looks
+ *	at the table when the soonest timer is due (NextDue), so it costs one compare a
+ *	millisecond the rest of the time.
+ *
+ *	delayms() and waittimer() idle the CPU until the time is up (see _idle), instead of
+ *	counting instructions like _delay_ms() - which the ISR throws off, by taking its cycles.
+ *
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.
+ *
+ *
+ */
+
+#include <inttypes.h>
+#include <avr/io.h>			/* this takes care of definitions for our specific AVR */
+#include <avr/interrupt.h>	/* for cli(), etc */
+#include <stdio.h>			// for NULL, FILE (miggl.h)
+
+#include "mydefs.h"
+
+#include "miggl.h"
+#include "miggl-private.h"
+
+
+struct timer {
+	uint32_t due;			// tick it goes off next
+	uint16_t period;		// ms between, after that (0 - it goes off once)
+	uint8_t on;				// 1 while it's running
+	uint8_t fired;			// times it has gone off since timerexpired (up to 255)
+};
+
+// shared with the ISR
+static struct timer Timers[MAXTIMERS];
+static uint8_t TimersOn;			// 1 if any timer is running
+static uint32_t NextDue;			// the soonest due tick of those
+
+
+// the soonest due tick of the running timers (and whether there are any).  (interrupts off)
+static void findnext(uint32_t now)
+{
+	struct timer *t;
+	uint8_t i;
+
+	TimersOn = 0;
+	NextDue = now + 0x7fffffffUL;
+	for (i = 0, t = Timers; i < MAXTIMERS; i++, t++) {
+		if (t->on) {
+			TimersOn = 1;
+			if ((int32_t)(t->due - NextDue) < 0) {
+				NextDue = t->due;
+			}
+		}
+	}
+}
+
+
+//
+// start timer n: it goes off in ms milliseconds (0 is the next tick), then every period ms
+//	(0 - just the once).  if it was running, it starts over, and its count is cleared.
+//
+void starttimer(uint8_t n, uint16_t ms, uint16_t period)
+{
+	struct timer *t;
+	uint8_t sreg;
+	uint32_t now;
+
+	if (n >= MAXTIMERS) {		// error check
+		return;
+	}
+	t = &Timers[n];
+
+	sreg = SREG;
+	cli();
+	now = _mstick();
+	t->due = now + (ms != 0 ? ms : 1);
+	t->period = period;
+	t->fired = 0;
+	t->on = 1;
+	findnext(now);
+	SREG = sreg;
+}
+
+//
+// stop timer n (if it has already gone off, timerexpired still says so)
+//
+void stoptimer(uint8_t n)
+{
+	uint8_t sreg;
+
+	if (n >= MAXTIMERS) {		// error check
+		return;
+	}
+
+	sreg = SREG;
+	cli();
+	Timers[n].on = 0;
+	findnext(_mstick());
+	SREG = sreg;
+}
+
+
+//
+// returns how many times timer n has gone off since the last call (0 if it hasn't)
+//
+uint8_t timerexpired(uint8_t n)
+{
+	uint8_t sreg, fired;
+
+	if (n >= MAXTIMERS) {		// error check
+		return 0;
+	}
+
+	sreg = SREG;
+	cli();
+	fired = Timers[n].fired;
+	Timers[n].fired = 0;
+	SREG = sreg;
+
+	return fired;
+}
+
+//
+// returns the timers that have gone off, and haven't been picked up by timerexpired yet
+//	(bit n for timer n)
+//
+uint8_t gettimers(void)
+{
+	uint8_t i, mask;
+
+	mask = 0;
+	for (i = 0; i < MAXTIMERS; i++) {
+		if (Timers[i].fired != 0) {			// (one byte - no need for cli)
+			mask |= _BV(i);
+		}
+	}
+	return mask;
+}
+
+//
+// returns the milliseconds until timer n goes off next (0 if it isn't running)
+//
+uint16_t timerleft(uint8_t n)
+{
+	uint8_t sreg;
+	uint32_t left;
+
+	if (n >= MAXTIMERS) {		// error check
+		return 0;
+	}
+
+	sreg = SREG;
+	cli();
+	left = Timers[n].on ? Timers[n].due - _mstick() : 0;
+	SREG = sreg;
+
+	return (left > 0xffff) ? 0xffff : left;
+}
+
+
+//
+// wait until timer n goes off (or right away if it already has, or isn't running).
+//	this picks up its count, like timerexpired.
+//
+void waittimer(uint8_t n)
+{
+	if (n >= MAXTIMERS) {		// error check
+		return;
+	}
+
+	while (Timers[n].fired == 0 && Timers[n].on) {
+		_idle();
+	}
+	timerexpired(n);
+}
+
+//
+// wait ms milliseconds (the CPU idles)
+//
+void delayms(uint16_t ms)
+{
+	uint32_t start;
+
+	start = gettick32();
+	while (gettick32() - start < ms) {
+		_idle();
+	}
+}
+
+
+//
+// timer portion of the display ISR - called every millisecond, with the new tick
+//
+void do_timer_isr(uint32_t now)
+{
+	struct timer *t;
+	uint8_t i;
+
+	if (!TimersOn || (int32_t)(now - NextDue) < 0) {
+		return;
+	}
+
+	for (i = 0, t = Timers; i < MAXTIMERS; i++, t++) {
+		if (t->on && (int32_t)(now - t->due) >= 0) {
+			if (t->fired != 255) {
+				t->fired++;
+			}
+			if (t->period != 0) {
+				t->due += t->period;
+			} else {
+				t->on = 0;
+			}
+		}
+	}
+	findnext(now);
+}
@@ -15,13 +15,8 @@
  *
  *	TODO:
  *
- *	- clean up initialization.. there should be one function miggl_init() or something like that.
- *		clean up global vars that shouldn't be exposed too.
- *
- *	- settempo() NYI
- *
- *	- really need to get rid of 48 entry duration table
- *		(use another counter and only re-calculate the 1/48 entry when tempo changes)
+ *	- clean up global vars that shouldn't be exposed.  (initialization is miggl_init() now -
+ *		see miggl-run.c.)
  *
  *	- could move wavetables into program memory (to save RAM)
  *
@@ -32,6 +27,93 @@
  *
  *	revision history:
  *
+ *	- oct 18, 2026 - jesse
+ *		add _RowPinsHeld (the display scan leaves those row pins high).
+ *
+ *	- oct 18, 2026 - jesse
+ *		_btninject() is only built with MIGGL_SESSION.
+ *
+ *	- oct 18, 2026 - jesse
+ *		dumplatency() converts ticks with TICK_US, so it's right for any TICKHZ (it assumed 50us).
+ *
+ *	- oct 18, 2026 - jesse
+ *		scroll() works out the source row in 16 bits, so a dy of -124 or less doesn't read
+ *		past Disp (it just clears the screen, like any dy of YSCREEN or more).
+ *
+ *	- oct 18, 2026 - jesse
+ *		flushbuttonevents() clears the gesture state too, so a button that was down (or its
+ *		flushed press) can't make a BE_TAP, BE_LONG or BE_REPEAT afterwards.
+ *
+ *	- oct 18, 2026 - jesse
+ *		swapbuffers() is _swapbegin() and _swapdone(), so the main loop (miggl-run.c) can do
+ *		other things while it waits for the swap.
+ *
+ *	- oct 18, 2026 - jesse
+ *		the millisecond tick is 32 bits (gettick32), and runs the software timers
+ *		(do_timer_isr - see miggl-timer.c).
+ *
+ *	- oct 18, 2026 - jesse
+ *		call do_link_isr() every millisecond.
+ *
+ *	- oct 18, 2026 - jesse
+ *		the ISR rate is TICKHZ (miggl.h), not a fixed 20khz.
+ *
+ *	- oct 18, 2026 - jesse
+ *		implement settempo().  the 48 entry duration table is gone: a duration is its value
+ *		times DurUnit (ticks per 1/12 beat), multiplied once per note.
+ *
+ *	- oct 18, 2026 - jesse
+ *		button presses feed the random seed (_seedpress, see miggl-seed.c).
+ *
+ *	- oct 18, 2026 - jesse
+ *		button events go to the session recorder, and a replay can inject them
+ *		(see miggl-session.c).
+ *
+ *	- oct 18, 2026 - jesse
+ *		getbuttonevent() can also report taps, long presses, auto-repeat and chords
+ *		(see setgestures).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add press-to-feedback latency probes (build with -DMIGGL_LATENCY): button edge to the
+ *		first display frame showing a change, and to the first audio sample.  see getlatency().
+ *
+ *	- oct 18, 2026 - jesse
+ *		add setinputmode(INPUT_PCINT): buttons are read in pin change interrupts (with a lockout
+ *		instead of debouncing), so presses are seen right away.  the wait functions (swapbuffers,
+ *		waitaudio, etc) idle the cpu instead of spinning.  add sleepuntilbutton() (power down).
+ *
+ *	- oct 18, 2026 - jesse
+ *		buttons are sampled and debounced in the ISR (every DEBOUNCE_MS), with a queue of
+ *		press/release events (getbuttonevent).  handlebuttons() now reports the debounced state,
+ *		and sees every button (not just one per call).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add setbrightness(): rows are blanked for part of each scan phase.
+ *
+ *	- oct 18, 2026 - jesse
+ *		display size and pin map are set at compile time (XSCREEN, YSCREEN, and DISP_GREENCOLS etc
+ *		in iodefs.h).  the scan code is generated from the pin map, and rows can be wider than 8 bits.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add a keyframe animation player (playanim, etc), stepped by the display ISR.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add a millisecond tick (gettick) and frame timing statistics (getframestats, etc).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add 5 phase scan mode (setscanmode) that drives green and red columns together.
+ *		the display part of the ISR is split into scan10() and scan5().
+ *
+ *	- oct 18, 2026 - jesse
+ *		add draw modes (setdrawmode) and an overlay layer that the ISR composites over Disp.
+ *		drawfilledrect() now draws a whole row per step.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add scroll(), scroll_wrap() and shift_in_column() - these move whole rows at a time.
+ *
+ *	- oct 18, 2026 - jesse
+ *		call do_text_isr() at the end of each frame (scrolling text, see miggl-text.c).
+ *
  *	- may 24, 2008 - rolf
  *		call this version 0.92.
  *
@@ -80,6 +162,7 @@
 #include <avr/io.h>			/* this takes care of definitions for our specific AVR */
 #include <avr/pgmspace.h>	/* needed for printf_P, etc */
 #include <avr/interrupt.h>	/* for interrupts, ISR macro, etc. */
+#include <avr/sleep.h>		/* for sleep_mode(), etc */
 #include <stdio.h>			// for sprintf, etc.
 //#include <string.h>			// for strcpy, etc.
 
@@ -98,6 +181,10 @@
 
 // global graphics state
 static uint8_t _CurColor = RED;
+static uint8_t _DrawMode = DM_SET;
+static volatile disprow_t *_DrawBuf = Disp;	// where drawing goes (Disp or Overlay)
+
+uint8_t _RowPinsHeld;						// row pins the scan leaves high (the UART's - see miggl-link.c)
 
 
 // globals for button handling
@@ -110,6 +197,49 @@ byte ButtonBEvent;
 byte ButtonCEvent;
 byte ButtonDEvent;
 
+static volatile uint8_t BtnState;		// debounced state (BTN_A, etc - 1 is down)
+static volatile uint8_t BtnPressed;		// presses not yet seen by handlebuttons()
+static uint8_t BtnCnt0 = 0xff, BtnCnt1 = 0xff;	// vertical counter (2 bits per button) - see do_buttons_isr()
+static uint8_t BtnSampleCount = DEBOUNCE_MS;	// milliseconds left until the next sample
+
+static uint8_t InputMode = INPUT_POLL;
+static volatile uint8_t BtnPressCount;	// counts presses (wraps) - see sleepuntilbutton()
+static uint8_t BtnLockMask;				// buttons in their lockout time (INPUT_PCINT only)
+static uint8_t BtnLock[4];				// milliseconds of lockout left, per button
+
+static struct buttonevent BtnQueue[BTNQ_SIZE];	// press/release events - see getbuttonevent()
+static volatile uint8_t BtnQHead;		// next free entry (written by the ISR)
+static volatile uint8_t BtnQTail;		// oldest entry (read by getbuttonevent)
+
+// gesture state (main loop only - see getbuttonevent)
+static uint8_t GestMask = GE_PRESS | GE_RELEASE;	// events to report
+static uint8_t GestDown;				// buttons down (as of the last raw event read)
+static uint8_t GestLong;				// buttons that have had their BE_LONG (no tap or repeat for them)
+static uint8_t GestChord;				// buttons that are part of a chord (no tap, long or repeat)
+static uint16_t GestPress[4];			// tick of each button's press
+static uint16_t GestRepeat[4];			// tick of each button's next BE_REPEAT
+static struct buttonevent GestPending[GESTQ_SIZE];	// events waiting to be returned
+static uint8_t GestHead, GestTail;
+
+
+// globals for latency measurement here (MIGGL_LATENCY only):
+
+#ifdef MIGGL_LATENCY
+#define LAT_DIRTY()		(DispDirty = 1)
+
+#define LAT_WAITDRAW	0x1		// waiting for a draw after the button edge
+#define LAT_WAITFRAME	0x2		// waiting for the frame that shows it to finish
+#define LAT_WAITPLAY	0x4		// waiting for playsong() after the button edge
+#define LAT_WAITAUDIO	0x8		// waiting for the first audio sample of that song
+
+static volatile uint8_t DispDirty;		// 1 if anything was drawn since the last display cycle
+static volatile uint8_t LatWait;		// LAT_WAITDRAW, etc
+static uint16_t LatEdge;				// fine tick (see finetick) of the last button press
+static struct latencystats LatStats[2];	// LAT_DISPLAY, LAT_AUDIO
+#else
+#define LAT_DIRTY()
+#endif
+
 
 // globals for audio here
 
@@ -153,18 +283,48 @@ static uint8_t SquareWtable[WTABSIZE] = {
 
 // globals for display/refresh here:
 
-static volatile uint8_t Rcount = 20;
+static volatile uint8_t Rcount = ROW_TICKS;
+static volatile uint8_t Rblank;		// the row output is blanked when Rcount gets down to this (see setbrightness)
 
+static uint8_t Brightness = 255;
+static uint8_t OnTicks = ROW_TICKS;			// ticks a row stays lit, in a ROW_TICKS phase
+static uint8_t OnTicks2 = 2*ROW_TICKS;		// same, in a 2*ROW_TICKS phase (SCAN_5PHASE)
 
-volatile uint8_t Disp[10];		// the display buffer (7 x 5 pixels ==> 10 rows of 7 pixels each, right-justified)
+static uint8_t ScanMode = SCAN_10PHASE;
+static uint8_t ScanHalf;		// 1 while showing the 1st half of a split phase (SCAN_5PHASE only)
 
-volatile uint8_t		CurRow;		// next display buffer row (of 5) to display
+
+volatile disprow_t Disp[DISPROWS];		// the display buffer (7 x 5 pixels ==> 10 rows of 7 pixels each, right-justified)
+
+volatile disprow_t Overlay[DISPROWS];	// overlay layer (same layout as Disp) - lit pixels hide the ones in Disp
+volatile uint8_t OverlayFlag;	// 1 if the overlay is shown
+
+volatile uint8_t		CurRow;		// next display buffer row (of 10), or display line (of 5) for SCAN_5PHASE
 
 volatile uint8_t 	SwapRelease;	// flag (1 bit)
 volatile uint8_t	SwapCounter;
 uint8_t				SwapInterval;
 
 
+// globals for animation here:
+
+static const uint8_t *AnimPtr;			// next keyframe (in program memory)
+static const uint8_t *AnimStart;		// first keyframe (for A_LOOP)
+static uint8_t AnimCount;				// frames left to show the current keyframe
+static volatile uint8_t AnimPlayFlag;	// 1 while an animation is playing
+
+
+// globals for timing here:
+
+static volatile uint32_t MsTick;		// milliseconds since start_timer1() (wraps after 49 days)
+static uint8_t MsCount = MS_TICKS;		// ISR ticks left in this millisecond
+
+static struct framestats FrameStats;	// see getframestats()
+static volatile uint8_t SwapWaiting;	// 1 while swapbuffers() is waiting for the release
+static volatile uint8_t FrameArmed;		// 1 once swapbuffers() has been called (stats mean something)
+static uint16_t FrameStart;				// tick when the main loop started the current frame
+
+
 // globals for audio here
 
 //const uint8_t* wavTables[];  // table of addresses of different waveform tables (SINE, SAW, TRIANGLE, SQUARE, WEIRD)
@@ -173,7 +333,7 @@ uint8_t* wavPtr;                    // this points to the currently active wavef
 uint16_t Wdur;        // duration for playing notes (these are in units of 50usec) -- initialize for 75 bpm (beats per minute)
 uint16_t Wnote_sep;   // small pause at end of each note (these are in units of 50usec)
 
-uint16_t DurTab[];    // table of durations for notes to play (48 durations)
+uint16_t DurUnit = DURUNIT(DEFAULTTEMPO);	// ticks per duration unit (see settempo)
 
 //extern const uint8_t* songTables[]; // table of addresses of different waveform tables (SINE, SAW, TRIANGLE, SQUARE, WEIRD)
 uint8_t* songPtr;				// this points into to the current song table
@@ -196,6 +356,75 @@ struct fixedPtNum WtabDelta;  // with this version of firmware we're limited to
 struct fixedPtNum WtabCount;
 
 
+//
+// ISR ticks (1/TICKHZ s - 50us at 20khz) since start_timer1() - wraps every 65536 ticks
+//	(3.2 seconds at 20khz).  (call from an ISR)
+//
+static inline uint16_t finetick(void)
+{
+	return (uint16_t)MsTick * MS_TICKS + (MS_TICKS - MsCount);
+}
+
+uint16_t _finetick(void)
+{
+	return finetick();
+}
+
+
+#ifdef MIGGL_LATENCY
+
+
+//
+// add the time since the last button press to latency counter which (LAT_DISPLAY, LAT_AUDIO).
+//	the histogram buckets are powers of 2 ms: under 1ms, under 2ms, under 4ms, ...
+//
+static void latsample(uint8_t which)
+{
+	struct latencystats *ls = &LatStats[which];
+	uint16_t t, ms;
+	uint8_t b;
+
+	t = finetick() - LatEdge;
+
+	if (ls->count == 0 || t < ls->min) {
+		ls->min = t;
+	}
+	if (t > ls->max) {
+		ls->max = t;
+	}
+	ls->sum += t;
+	ls->count++;
+
+	ms = t / MS_TICKS;
+	for (b = 0; ms != 0 && b < LAT_BUCKETS-1; b++) {
+		ms >>= 1;
+	}
+	ls->hist[b]++;
+}
+
+
+// a button was pressed: start timing (call from an ISR)
+static inline void latedge(void)
+{
+	LatEdge = finetick();
+	LatWait = LAT_WAITDRAW | LAT_WAITPLAY;
+}
+
+
+// the end of a display cycle (call from the ISR)
+static inline void latframe(void)
+{
+	if (LatWait & LAT_WAITFRAME) {			// a whole frame has shown the change
+		LatWait &= ~LAT_WAITFRAME;
+		latsample(LAT_DISPLAY);
+	} else if ((LatWait & LAT_WAITDRAW) && DispDirty) {
+		LatWait = (LatWait & ~LAT_WAITDRAW) | LAT_WAITFRAME;
+	}
+	DispDirty = 0;
+}
+#endif
+
+
 //
 // audio portion of timer ISR
 //
@@ -229,6 +458,12 @@ void do_audio_isr(void)
         else {
             TCCR1A |= _BV(COM1A1);   // make sure audio is turned on by turning on compare reg
             OCR1A = PWMval;          // set the PWM time to next value (that was calculated on the previous pass through the ISR)
+#ifdef MIGGL_LATENCY
+            if ((LatWait & LAT_WAITAUDIO) && PWMval != 0) {
+                LatWait &= ~LAT_WAITAUDIO;
+                latsample(LAT_AUDIO);
+            }
+#endif
         }
 
         // calculate the next PWM value (this value will be used next time we get a timer interrrupt)
@@ -317,6 +552,371 @@ void do_audio_isr(void)
 }
 
 
+//
+// returns display row i (0-4 green, 5-9 red) as it should be shown,
+//	with the overlay (if on) composited over Disp.
+//
+static inline disprow_t scanrow(uint8_t i)
+{
+	uint8_t y;
+	disprow_t mask;
+
+	if (!OverlayFlag) {
+		return Disp[i];
+	}
+	y = (i < YSCREEN) ? i : i - YSCREEN;
+	mask = Overlay[y] | Overlay[y+YSCREEN];		// any lit overlay pixel is opaque
+	return (Disp[i] & ~mask) | Overlay[i];
+}
+
+
+//
+// animation portion of the display ISR - called once per frame (see swapinterval).
+//
+static inline void do_anim_isr(void)
+{
+	uint8_t dur, i;
+
+	if (!AnimPlayFlag) {
+		return;
+	}
+	if (--AnimCount != 0) {
+		return;
+	}
+
+	dur = pgm_read_byte(AnimPtr);
+	if (dur == A_LOOP) {
+		AnimPtr = AnimStart;
+		dur = pgm_read_byte(AnimPtr);
+	}
+	if (dur == A_END) {
+		AnimPlayFlag = 0;				// all done (the last keyframe stays on the display)
+		return;
+	}
+	AnimPtr++;
+
+	for (i = 0; i < DISPROWS; i++) {
+		Disp[i] = pgm_read_row(AnimPtr);
+		AnimPtr += sizeof(disprow_t);
+	}
+	AnimCount = dur;
+}
+
+
+//
+// end of a display cycle (all rows shown once)
+//
+static inline void endofcycle(void)
+{
+#ifdef MIGGL_LATENCY
+	latframe();
+#endif
+
+	if (--SwapCounter == 0) {			// we count down display cycles...
+		SwapCounter = SwapInterval;
+		SwapRelease = 1;				// now mark the end of the display cycle
+		if (FrameArmed && !SwapWaiting) {
+			FrameStats.missed++;		// main loop wasn't ready to flip in time
+		}
+
+		do_anim_isr();					// show the next keyframe (if it's time)
+		do_text_isr();					// scroll in the next column of text (if any)
+	}
+}
+
+
+//
+// the scan code below is generated from the pin map in iodefs.h:
+//	DISP_GREENCOLS() and DISP_REDCOLS() list the column pins of each display line,
+//	and DISP_WRITEROW() puts the pixel bits of one row out on the row pins.
+//	every pin is a constant inside its own case, so each one is still a single instruction.
+//
+
+#define _COL_COUNT(n, pin)			+1
+#define _COL_OFF(n, pin)			output_low(pin);
+#define _GCOL_CASE_ON(n, pin)		case (n): output_high(pin); break;
+#define _GCOL_CASE_OFF(n, pin)		case (n): output_low(pin); break;
+#define _RCOL_CASE_ON(n, pin)		case (n)+YSCREEN: output_high(pin); break;
+#define _RCOL_CASE_OFF(n, pin)		case (n)+YSCREEN: output_low(pin); break;
+
+// the pin map must have one green and one red column per display line
+enum { _NGREENCOLS = 0 DISP_GREENCOLS(_COL_COUNT), _NREDCOLS = 0 DISP_REDCOLS(_COL_COUNT) };
+typedef char _pinmap_check[(_NGREENCOLS == YSCREEN && _NREDCOLS == YSCREEN) ? 1 : -1];
+
+
+//
+// turn off all columns (green and red)
+//
+static inline void columns_off(void)
+{
+	DISP_GREENCOLS(_COL_OFF)
+	DISP_REDCOLS(_COL_OFF)
+}
+
+
+//
+// turn on/off the column of display buffer row i (0 to YSCREEN-1 green, then red)
+//
+static inline void column_on(uint8_t i)
+{
+	switch (i) {
+		DISP_GREENCOLS(_GCOL_CASE_ON)
+		DISP_REDCOLS(_RCOL_CASE_ON)
+	}
+}
+
+static inline void column_off(uint8_t i)
+{
+	switch (i) {
+		DISP_GREENCOLS(_GCOL_CASE_OFF)
+		DISP_REDCOLS(_RCOL_CASE_OFF)
+	}
+}
+
+
+//
+// turn on the green and/or red column (COL_GREEN, COL_RED) of display line y
+//
+static inline void columns_on(uint8_t y, uint8_t cols)
+{
+	if (cols & COL_GREEN) {
+		column_on(y);
+	}
+	if (cols & COL_RED) {
+		column_on(y + YSCREEN);
+	}
+}
+
+
+//
+// read the buttons (BTN_A, etc - 1 is down)
+//
+static inline uint8_t readbuttons(void)
+{
+	uint8_t raw;
+
+	raw = 0;
+	if (button_pressed(SW1)) raw |= BTN_A;
+	if (button_pressed(SW2)) raw |= BTN_B;
+	if (button_pressed(SW3)) raw |= BTN_C;
+	if (button_pressed(SW4)) raw |= BTN_D;
+
+	return raw;
+}
+
+
+//
+// the buttons in changed have just gone down or up (debounced) - update the state and
+// queue the events.  (called from an ISR)
+//
+static void btnchange(uint8_t changed)
+{
+	uint8_t b, i, head;
+
+	BtnState ^= changed;
+	BtnPressed |= BtnState & changed;
+
+	for (b = BTN_A, i = 0; b <= BTN_D; b <<= 1, i++) {
+		if (changed & b) {
+			if (BtnState & b) {
+				BtnPressCount++;
+				_seedpress();
+#ifdef MIGGL_LATENCY
+				latedge();
+#endif
+			}
+			_sessionevent(i, (BtnState & b) ? BE_PRESS : BE_RELEASE);
+			head = (BtnQHead + 1) & (BTNQ_SIZE-1);
+			if (head != BtnQTail) {		// (if the queue is full, the event is dropped)
+				BtnQueue[BtnQHead].button = b;
+				BtnQueue[BtnQHead].type = (BtnState & b) ? BE_PRESS : BE_RELEASE;
+				BtnQueue[BtnQHead].tick = MsTick;
+				BtnQHead = head;
+			}
+		}
+	}
+}
+
+
+#ifdef MIGGL_SESSION
+//
+// set button b (BTN_A, etc) down (1) or up (0), as if it had been pressed or released.
+//	(used by the session replay, from the ISR)
+//
+void _btninject(uint8_t b, uint8_t down)
+{
+	if (((BtnState & b) != 0) != down) {
+		btnchange(b);
+	}
+}
+#endif
+
+
+//
+// button portion of the ISR (INPUT_POLL) - called every DEBOUNCE_MS milliseconds.
+//
+//	the four buttons are debounced together with a "vertical counter": bit n of BtnCnt0 and
+//	BtnCnt1 make up a 2-bit counter for button n.  a button's counter runs while its sample
+//	differs from the debounced state, and is reset when it agrees, so a change has to be seen
+//	4 samples in a row (20ms) to count.
+//
+static inline void do_buttons_isr(void)
+{
+	uint8_t changed;
+
+	if (_Replaying) {					// (the real buttons are ignored during a replay)
+		return;
+	}
+
+	changed = BtnState ^ readbuttons();
+	BtnCnt0 = ~(BtnCnt0 & changed);
+	BtnCnt1 = BtnCnt0 ^ (BtnCnt1 & changed);
+	changed &= BtnCnt0 & BtnCnt1;		// counters that rolled over
+
+	if (changed != 0) {
+		btnchange(changed);
+	}
+}
+
+
+//
+// INPUT_PCINT: a button's first edge counts right away, then the button is locked out
+// (its edges are ignored) for BTN_LOCKOUT_MS, while it bounces.  at the end of the lockout,
+// we look at the button again, in case it was released (or pressed) in the meantime.
+//
+static void pcint_buttons(void)
+{
+	uint8_t changed, b, i;
+
+	if (_Replaying) {					// (the real buttons are ignored during a replay)
+		return;
+	}
+
+	changed = (BtnState ^ readbuttons()) & ~BtnLockMask;
+	if (changed == 0) {
+		return;
+	}
+	btnchange(changed);
+
+	BtnLockMask |= changed;
+	for (b = BTN_A, i = 0; b <= BTN_D; b <<= 1, i++) {
+		if (changed & b) {
+			BtnLock[i] = BTN_LOCKOUT_MS;
+		}
+	}
+}
+
+// lockout portion of the ISR (INPUT_PCINT) - called every millisecond
+static inline void do_lockout_isr(void)
+{
+	uint8_t b, i;
+
+	for (b = BTN_A, i = 0; b <= BTN_D; b <<= 1, i++) {
+		if ((BtnLockMask & b) && --BtnLock[i] == 0) {
+			BtnLockMask &= ~b;
+		}
+	}
+	pcint_buttons();		// (catches changes made during a lockout)
+}
+
+
+ISR(PCINT0_vect)		// SW1, SW2
+{
+	pcint_buttons();
+}
+
+ISR(PCINT1_vect)		// SW3
+{
+	pcint_buttons();
+}
+
+ISR(PCINT2_vect)		// SW4
+{
+	pcint_buttons();
+}
+
+
+//
+// start a scan phase ticks long, with row bits lit for the first on ticks of it.
+//	(the ISR blanks the row output when the on time is up)
+//
+static inline void startphase(uint8_t ticks, uint8_t on, disprow_t bits)
+{
+	Rcount = ticks;
+	Rblank = ticks - on;
+	DISP_WRITEROW((on != 0) ? bits : 0);
+}
+
+
+//
+// 10 phase scan (SCAN_10PHASE):
+//	we display green columns (5) followed by the red columns (5).
+//	each will stay on for ROW_TICKS ticks (20 ticks is about 1ms).
+//
+//	(on other display sizes, this is one phase per row of Disp, i.e. 2*YSCREEN phases)
+//
+static inline void scan10(void)
+{
+	column_off((CurRow == 0) ? DISPROWS-1 : CurRow-1);
+	startphase(ROW_TICKS, OnTicks, scanrow(CurRow));
+	column_on(CurRow);
+
+	CurRow++;
+	if (CurRow >= DISPROWS) {
+		CurRow = 0;
+		endofcycle();
+	}
+}
+
+
+//
+// 5 phase scan (SCAN_5PHASE):
+//	each phase lights the green and red columns of one display line at the same time,
+//	for twice as long (so the display cycle is the same length as in the 10 phase scan,
+//	but every LED gets twice the on time).
+//
+//	note: the row lines are shared, so the two columns can only be lit together when the line
+//	is all yellow/black, or one of its planes is empty.  a line with mixed colors gets its
+//	phase split in half - green, then red - just like the 10 phase scan.
+//
+//	(on other display sizes, this is one phase per display line, i.e. YSCREEN phases)
+//
+static inline void scan5(void)
+{
+	disprow_t g, r;
+
+	columns_off();
+
+	if (ScanHalf) {						// 2nd half of a split phase: red
+		startphase(ROW_TICKS, OnTicks, scanrow(CurRow+YSCREEN));
+		columns_on(CurRow, COL_RED);
+		ScanHalf = 0;
+	} else {
+		g = scanrow(CurRow);
+		r = scanrow(CurRow+YSCREEN);
+
+		if (g == r || r == 0) {			// yellow/black, or green/black
+			startphase(2*ROW_TICKS, OnTicks2, g);
+			columns_on(CurRow, (r != 0) ? (COL_GREEN | COL_RED) : COL_GREEN);
+		} else if (g == 0) {			// red/black
+			startphase(2*ROW_TICKS, OnTicks2, r);
+			columns_on(CurRow, COL_RED);
+		} else {						// mixed: green now, red next time
+			startphase(ROW_TICKS, OnTicks, g);
+			columns_on(CurRow, COL_GREEN);
+			ScanHalf = 1;
+			return;
+		}
+	}
+
+	CurRow++;
+	if (CurRow >= YSCREEN) {
+		CurRow = 0;
+		endofcycle();
+	}
+}
+
+
 ISR(TIMER1_OVF_vect)
 {
 
@@ -324,88 +924,37 @@ ISR(TIMER1_OVF_vect)
 	do_audio_isr();
 
 
-	// next, handle the display
+	// keep time
 
-	if (--Rcount == 0) {		// do we display a new row this time?  (only every 20 or so)
-		Rcount = 20;
-
-		//
-		// we display green columns (5) followed by the red columns (5).
-		// each will stay on for "Rcount" ticks (20 ticks is about 1ms).
-		//
-		switch (CurRow) {
-			case 0:
-				output_low(RC5);
-				PORTD = Disp[0] | 0x80;		// note: keep PD7 high (pullup for SW4)
-				output_high(GC1);
-				break;
-
-			case 1:
-				output_low(GC1);
-				PORTD = Disp[1] | 0x80;
-				output_high(GC2);
-				break;
-
-			case 2:
-				output_low(GC2);
-				PORTD = Disp[2] | 0x80;
-				output_high(GC3);
-				break;
-
-			case 3:
-				output_low(GC3);
-				PORTD = Disp[3] | 0x80;
-				output_high(GC4);
-				break;
-
-			case 4:
-				output_low(GC4);
-				PORTD = Disp[4] | 0x80;
-				output_high(GC5);
-				break;
-
-			case 5:
-				output_low(GC5);
-				PORTD = Disp[5] | 0x80;
-				output_high(RC1);
-				break;
-
-			case 6:
-				output_low(RC1);
-				PORTD = Disp[6] | 0x80;
-				output_high(RC2);
-				break;
-
-			case 7:
-				output_low(RC2);
-				PORTD = Disp[7] | 0x80;
-				output_high(RC3);
-				break;
-
-			case 8:
-				output_low(RC3);
-				PORTD = Disp[8] | 0x80;
-				output_high(RC4);
-				break;
-
-			case 9:
-				output_low(RC4);
-				PORTD = Disp[9] | 0x80;
-				output_high(RC5);
-				break;
-
-		}	// switch
-
-
-		CurRow++;
-		if (CurRow >= 10) {
-			CurRow = 0;
-			if (--SwapCounter == 0) {			// we count down display cycles...
-				SwapCounter = SwapInterval;
-				SwapRelease = 1;				// now mark the end of the display cycle
+	if (--MsCount == 0) {
+		MsCount = MS_TICKS;
+		MsTick++;
+
+		if (InputMode == INPUT_PCINT) {
+			if (BtnLockMask) {
+				do_lockout_isr();
 			}
+		} else if (--BtnSampleCount == 0) {
+			BtnSampleCount = DEBOUNCE_MS;
+			do_buttons_isr();
 		}
 
+		do_session_isr();		// record or replay button events (if any)
+		do_link_isr();			// talk to the other board (if linked)
+		do_timer_isr(MsTick);	// software timers (if any are due)
+	}
+
+
+	// next, handle the display
+
+	if (--Rcount == 0) {		// do we display a new row this time?  (only every 20 or so)
+		if (ScanMode == SCAN_5PHASE) {
+			scan5();
+		} else {
+			scan10();
+		}
+	} else if (Rcount == Rblank) {	// on time is up for this row (see setbrightness)
+		DISP_WRITEROW(0);
 	}
 }
 
@@ -421,7 +970,7 @@ void start_timer1(void)
 	// initialize ICR1, which sets the "TOP" value for the counter to interrupt and start over
 	// note: value of 50-1 ==> 20khz (assumes 8mhz clock, prescaled by 1/8)
 	//ICR1 = 50-1;
-	ICR1 = 50-1;
+	ICR1 = (1000000UL / TICKHZ) - 1;
 	OCR1A = 25;
 
 	//
@@ -477,6 +1026,14 @@ void avrinit(void)
 
 void button_init(void)
 {
+	uint8_t sreg;
+
+	sreg = SREG;
+	cli();
+	BtnPressed = 0;
+	BtnQTail = BtnQHead;
+	SREG = sreg;
+
 	ButtonA = 0;
 	ButtonB = 0;
 	ButtonC = 0;
@@ -488,85 +1045,376 @@ void button_init(void)
 }
 
 
-void poll_buttons(void)
+//
+// update ButtonA, etc from the debounced button state.
+//
+void poll_buttons(void)
 {
-	// clear the state of a button, if it has been released
+	uint8_t state;
 
-	if (ButtonA) {
-		if (!button_pressed(SW1)) {
-			ButtonA = 0;
-		}
+	state = BtnState;
+
+	ButtonA = (state & BTN_A) ? 1 : 0;
+	ButtonB = (state & BTN_B) ? 1 : 0;
+	ButtonC = (state & BTN_C) ? 1 : 0;
+	ButtonD = (state & BTN_D) ? 1 : 0;
+}
+
+
+//
+// this watches for button "events" and performs actions accordingly.
+//
+//	ButtonA, etc are 1 while the button is down.  ButtonAEvent, etc are 1 if the button was
+//	pressed since the last call - a press that was already released again still shows up
+//	in ButtonA, etc for this one call, so it isn't missed.
+//
+void handlebuttons(void)
+{
+	uint8_t sreg, pressed;
+
+	sreg = SREG;
+	cli();
+	pressed = BtnPressed;
+	BtnPressed = 0;
+	SREG = sreg;
+
+	poll_buttons();
+
+	ButtonAEvent = (pressed & BTN_A) ? 1 : 0;
+	ButtonBEvent = (pressed & BTN_B) ? 1 : 0;
+	ButtonCEvent = (pressed & BTN_C) ? 1 : 0;
+	ButtonDEvent = (pressed & BTN_D) ? 1 : 0;
+
+	ButtonA |= ButtonAEvent;
+	ButtonB |= ButtonBEvent;
+	ButtonC |= ButtonCEvent;
+	ButtonD |= ButtonDEvent;
+}
+
+
+//
+// returns the debounced button state (BTN_A, etc - 1 is down).
+//
+uint8_t getbuttons(void)
+{
+	return BtnState;
+}
+
+
+//
+// get the oldest raw (press/release) event from the ISR's queue.
+//	the queue holds BTNQ_SIZE-1 events - if it isn't read often enough, newer events are lost.
+//
+static uint8_t popbuttonevent(struct buttonevent *ev)
+{
+	uint8_t tail;
+
+	tail = BtnQTail;
+	if (tail == BtnQHead) {
+		return 0;
 	}
-	if (ButtonB) {
-		if (!button_pressed(SW2)) {
-			ButtonB = 0;
+	*ev = BtnQueue[tail];
+	BtnQTail = (tail + 1) & (BTNQ_SIZE-1);		// (only we write BtnQTail, and the ISR won't touch this entry)
+	return 1;
+}
+
+
+// queue an event for getbuttonevent() to return, if it is enabled (see setgestures)
+static void gestevent(uint8_t button, uint8_t type, uint16_t tick)
+{
+	uint8_t head;
+
+	if (!(GestMask & _BV(type))) {
+		return;
+	}
+	head = (GestHead + 1) & (GESTQ_SIZE-1);
+	if (head != GestTail) {
+		GestPending[GestHead].button = button;
+		GestPending[GestHead].type = type;
+		GestPending[GestHead].tick = tick;
+		GestHead = head;
+	}
+}
+
+
+// time has passed: BE_LONG and BE_REPEAT for the buttons being held
+static void gesttime(uint16_t now)
+{
+	uint8_t b, i;
+
+	for (b = BTN_A, i = 0; b <= BTN_D; b <<= 1, i++) {
+		if (!(GestDown & b) || (GestChord & b)) {
+			continue;
+		}
+		if (!(GestLong & b) && (int16_t)(now - GestPress[i]) >= GEST_LONG_MS
+				&& (GestMask & GE_LONG)) {
+			GestLong |= b;
+			gestevent(b, BE_LONG, GestPress[i] + GEST_LONG_MS);
+		}
+		if (!(GestLong & b) && (int16_t)(now - GestRepeat[i]) >= 0) {
+			gestevent(b, BE_REPEAT, GestRepeat[i]);
+			GestRepeat[i] += GEST_REPEAT_MS;
 		}
 	}
-	if (ButtonC) {
-		if (!button_pressed(SW3)) {
-			ButtonC = 0;
+}
+
+
+// a raw press or release
+static void gestraw(struct buttonevent *ev)
+{
+	uint8_t b, i, j, chord;
+
+	b = ev->button;
+	for (i = 0; (BTN_A << i) != b; i++)
+		;
+
+	if (ev->type == BE_PRESS) {
+		GestDown |= b;
+		GestLong &= ~b;
+		GestPress[i] = ev->tick;
+		GestRepeat[i] = ev->tick + GEST_REPEAT_DELAY_MS;
+		gestevent(b, BE_PRESS, ev->tick);
+
+		// a chord is buttons pressed within GEST_CHORD_MS of each other, and all still down
+		chord = b;
+		for (j = 0; j < 4; j++) {
+			if ((GestDown & (BTN_A << j)) && j != i && !(GestChord & (BTN_A << j))
+					&& (uint16_t)(ev->tick - GestPress[j]) <= GEST_CHORD_MS) {
+				chord |= BTN_A << j;
+			}
+		}
+		if (chord != b && (GestMask & GE_CHORD)) {
+			GestChord |= chord;
+			gestevent(chord, BE_CHORD, ev->tick);
 		}
+	} else {
+		gestevent(b, BE_RELEASE, ev->tick);
+		if ((GestDown & b) && (uint16_t)(ev->tick - GestPress[i]) < GEST_LONG_MS
+				&& !(GestChord & b)) {
+			gestevent(b, BE_TAP, ev->tick);		// (not if its press was flushed)
+		}
+		GestDown &= ~b;
+		GestChord &= ~b;
 	}
-	if (ButtonD) {
-		if (!button_pressed(SW4)) {
-			ButtonD = 0;
+}
+
+
+//
+// get the oldest button event.
+//	returns 1 and fills in ev if there was one, 0 if there wasn't.
+//
+//	besides BE_PRESS and BE_RELEASE, the events can be gestures (turn them on with setgestures):
+//	BE_TAP - a button was released before it became a long press.
+//	BE_LONG - a button has been held down for GEST_LONG_MS.
+//	BE_REPEAT - a held button repeats, GEST_REPEAT_DELAY_MS after the press and then every
+//		GEST_REPEAT_MS, until it is released or becomes a long press (if BE_LONG is on).
+//	BE_CHORD - two or more buttons were pressed within GEST_CHORD_MS of each other.
+//		ev->button has all of them (e.g. BTN_A | BTN_D).  buttons in a chord don't
+//		tap, long press or repeat - so with chords on, use BE_TAP for single buttons.
+//
+//	gestures are worked out here, from the timestamped press/release events, so they cost
+//	nothing in the ISR.  the tick of a gesture is when it happened, even if we're called late.
+//
+uint8_t getbuttonevent(struct buttonevent *ev)
+{
+	struct buttonevent raw;
+
+	for (;;) {
+		if (GestTail != GestHead) {
+			*ev = GestPending[GestTail];
+			GestTail = (GestTail + 1) & (GESTQ_SIZE-1);
+			return 1;
+		}
+		if (popbuttonevent(&raw)) {
+			gesttime(raw.tick);
+			gestraw(&raw);
+		} else {
+			gesttime(gettick());
+			if (GestTail == GestHead) {
+				return 0;
+			}
 		}
 	}
+}
 
+
+//
+// choose the events getbuttonevent() returns: any of GE_PRESS, GE_RELEASE, GE_TAP, GE_LONG,
+//	GE_REPEAT and GE_CHORD, or'd together.  the default is GE_PRESS | GE_RELEASE.
+//
+void setgestures(uint8_t mask)
+{
+	GestMask = mask;
 }
 
 
 //
-// this watches for button "events" and performs actions accordingly.
+// throw away any queued button events.  a button that's down now starts over: it won't
+//	tap, long press or repeat until it's pressed again.
 //
-void handlebuttons(void)
+void flushbuttonevents(void)
 {
+	BtnQTail = BtnQHead;
+	GestTail = GestHead;
+	GestDown = 0;
+	GestLong = 0;
+	GestChord = 0;
+}
 
-	if (!ButtonA && button_pressed(SW1)) {
-	
-		ButtonA = 1;
 
-		// action
-		ButtonAEvent = 1;
+// enable or disable the pin change interrupt for an I/O pin
+static inline void pcintpin(uint8_t pin, uint8_t on)
+{
+	volatile uint8_t *msk;
 
-	} else if (!ButtonB && button_pressed(SW2)) {
+	if (pin < 16) {
+		msk = &PCMSK0;		// PORTB
+	} else if (pin < 24) {
+		msk = &PCMSK1;		// PORTC
+	} else {
+		msk = &PCMSK2;		// PORTD
+	}
 
-		ButtonB = 1;
-	
-		// action
-		ButtonBEvent = 1;
-		
-	} else if (!ButtonC && button_pressed(SW3)) {
+	if (on) {
+		*msk |= _BV(pin & 7);
+	} else {
+		*msk &= ~_BV(pin & 7);
+	}
+}
 
-		ButtonC = 1;
-	
-		// action
-		ButtonCEvent = 1;
-		
-	} else if (!ButtonD && button_pressed(SW4)) {
 
-		ButtonD = 1;
-	
-		// action
-		ButtonDEvent = 1;
-		
+//
+// choose how the buttons are read:
+//	INPUT_POLL (the default) - sampled in the display ISR every DEBOUNCE_MS, and debounced.
+//		a change takes 20ms to show up.
+//	INPUT_PCINT - pin change interrupts.  a change shows up within microseconds, then the
+//		button is ignored for BTN_LOCKOUT_MS while it bounces.
+//
+//	either way, the results come through handlebuttons(), getbuttons() and getbuttonevent().
+//
+void setinputmode(uint8_t mode)
+{
+	uint8_t sreg, on;
+
+	on = (mode == INPUT_PCINT);
+
+	sreg = SREG;
+	cli();
+
+	InputMode = on ? INPUT_PCINT : INPUT_POLL;
+	BtnLockMask = 0;
+	BtnCnt0 = BtnCnt1 = 0xff;			// (vertical counters idle)
+
+	pcintpin(SW1, on);
+	pcintpin(SW2, on);
+	pcintpin(SW3, on);
+	pcintpin(SW4, on);
+	PCIFR = _BV(PCIF0) | _BV(PCIF1) | _BV(PCIF2);		// (clear any old pin changes)
+	if (on) {
+		PCICR |= _BV(PCIE0) | _BV(PCIE1) | _BV(PCIE2);
 	} else {
-		poll_buttons();
+		PCICR &= ~(_BV(PCIE0) | _BV(PCIE1) | _BV(PCIE2));
 	}
+
+	SREG = sreg;
+}
+
+
+uint8_t getinputmode(void)
+{
+	return InputMode;
+}
+
+
+//
+// idle the cpu until the next interrupt (at most one ISR tick, 1/TICKHZ s).
+//	the wait functions call this instead of spinning.
+//
+void _idle(void)
+{
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	sleep_mode();
+}
+
+
+//
+// turn the display off and power down until a button is pressed (the press is reported
+//	as usual).  this draws almost no current - nothing runs, including the display, audio
+//	and the millisecond tick (so gettick doesn't count the time asleep).
+//	the display comes back on, as it was, when we return.
+//
+//	note: make sure audio is finished first (e.g. waitaudio), or the speaker may be left on.
+//
+void sleepuntilbutton(void)
+{
+	uint8_t oldmode, count;
+
+	oldmode = InputMode;
+	setinputmode(INPUT_PCINT);			// pin changes wake us up
+
+	count = BtnPressCount;
+	set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+
+	for (;;) {
+		cli();
+		if (BtnPressCount != count) {
+			break;
+		}
+		columns_off();
+		DISP_WRITEROW(0);
+		sleep_enable();
+		sei();
+		sleep_cpu();		// (interrupts are on again after the sei, so a press can't be missed here)
+		sleep_disable();
+	}
+	sei();
+
+	setinputmode(oldmode);
 }
 
 
 /*
- *	wait (spin) until display cycle has finished
+ *	wait (idle) until display cycle has finished
  *
  */
 void swapbuffers(void)
 {
-	while (!SwapRelease) {		// spin until this flag is set
-		NOP();
+	_swapbegin();
+	while (!_swapdone()) {		// wait until the release
+		_idle();
+	}
+}
+
+// the frame is drawn: from now on, we're waiting for the swap
+void _swapbegin(void)
+{
+	uint16_t t;
+
+	if (FrameArmed) {			// how long did the main loop take this frame?
+		t = gettick() - FrameStart;
+		FrameStats.last = t;
+		if (t > FrameStats.worst) {
+			FrameStats.worst = t;
+		}
+	}
+
+	SwapWaiting = 1;
+}
+
+// returns 1 (and starts the next frame) if the display cycle has finished since _swapbegin
+uint8_t _swapdone(void)
+{
+	if (!SwapRelease) {
+		return 0;
 	}
 	NOP();
 	SwapRelease = 0;			// clear flag (for next time)
+	SwapWaiting = 0;
+
+	FrameStats.presented++;
+	FrameArmed = 1;
+	FrameStart = gettick();
+	return 1;
 }
 
 void initswapbuffers(void)
@@ -574,6 +1422,7 @@ void initswapbuffers(void)
 	SwapRelease = 0;
 	SwapInterval = 1;
 	SwapCounter = 1;
+	resetframestats();
 }
 
 void swapinterval(uint8_t i)
@@ -584,15 +1433,217 @@ void swapinterval(uint8_t i)
 }
 
 
+//
+// returns the millisecond tick (counts up from start_timer1, and wraps every 65.5 seconds).
+//	compare ticks by subtracting, e.g. (gettick() - start) >= 500
+//
+uint16_t gettick(void)
+{
+	uint8_t sreg;
+	uint16_t t;
+
+	sreg = SREG;
+	cli();				// the ISR could change MsTick between reading its bytes
+	t = MsTick;
+	SREG = sreg;
+
+	return t;
+}
+
+//
+// returns the whole millisecond tick (it wraps after 49 days, so for most things, gettick
+//	is enough - and quicker)
+//
+uint32_t gettick32(void)
+{
+	uint8_t sreg;
+	uint32_t t;
+
+	sreg = SREG;
+	cli();
+	t = MsTick;
+	SREG = sreg;
+
+	return t;
+}
+
+// the millisecond tick (call with interrupts off - e.g. miggl-timer.c)
+uint32_t _mstick(void)
+{
+	return MsTick;
+}
+
+
+//
+// get the frame timing statistics:
+//	presented - number of frames flipped by swapbuffers()
+//	missed - number of frames where the main loop wasn't waiting in swapbuffers() in time
+//	worst, last - longest and most recent main loop time (swapbuffers to swapbuffers), in ms
+//
+void getframestats(struct framestats *fs)
+{
+	uint8_t sreg;
+
+	sreg = SREG;
+	cli();				// missed is counted in the ISR
+	*fs = FrameStats;
+	SREG = sreg;
+}
+
+
+void resetframestats(void)
+{
+	uint8_t sreg;
+
+	sreg = SREG;
+	cli();
+	FrameStats.presented = 0;
+	FrameStats.missed = 0;
+	FrameStats.worst = 0;
+	FrameStats.last = 0;
+	FrameArmed = 0;			// (re-armed by the next swapbuffers)
+	SREG = sreg;
+}
+
+
+//
+// print the frame timing statistics to fp (e.g. a uart stream)
+//
+void dumpframestats(FILE *fp)
+{
+	struct framestats fs;
+
+	getframestats(&fs);
+	fprintf_P(fp, PSTR("frames %u missed %u worst %u ms last %u ms\n"),
+		fs.presented, fs.missed, fs.worst, fs.last);
+}
+
+
+#ifdef MIGGL_LATENCY
+//
+// press-to-feedback latency (build with -DMIGGL_LATENCY):
+//	LAT_DISPLAY - from a button press to the end of the first display frame that shows
+//		something drawn after the press.
+//	LAT_AUDIO - from a button press to the first non-zero audio sample (OCR1A) of the first
+//		song started (playsong) after it.
+//
+//	times are in ISR ticks (1/TICKHZ s).  a press that isn't followed by any drawing (or audio)
+//	isn't counted, and a new press restarts the timing.
+//
+void getlatency(uint8_t which, struct latencystats *ls)
+{
+	uint8_t sreg;
+
+	sreg = SREG;
+	cli();
+	*ls = LatStats[which & 1];
+	SREG = sreg;
+}
+
+
+void resetlatency(void)
+{
+	uint8_t sreg, i, b;
+
+	sreg = SREG;
+	cli();
+	for (i = 0; i < 2; i++) {
+		LatStats[i].count = 0;
+		LatStats[i].min = 0;
+		LatStats[i].max = 0;
+		LatStats[i].sum = 0;
+		for (b = 0; b < LAT_BUCKETS; b++) {
+			LatStats[i].hist[b] = 0;
+		}
+	}
+	LatWait = 0;
+	SREG = sreg;
+}
+
+
+//
+// print the latency counters to fp (e.g. a uart stream), in microseconds.
+//	the histogram is the count under 1ms, under 2ms, under 4ms, ... (the last is the rest)
+//
+void dumplatency(FILE *fp)
+{
+	struct latencystats ls;
+	uint8_t i, b;
+
+	for (i = 0; i < 2; i++) {
+		getlatency(i, &ls);
+		fprintf_P(fp, (i == LAT_DISPLAY) ? PSTR("display") : PSTR("audio"));
+		fprintf_P(fp, PSTR(" n %u min %lu avg %lu max %lu us |"), ls.count,
+			ls.min * TICK_US, ls.count ? (ls.sum / ls.count) * TICK_US : 0UL, ls.max * TICK_US);
+		for (b = 0; b < LAT_BUCKETS; b++) {
+			fprintf_P(fp, PSTR(" %u"), ls.hist[b]);
+		}
+		fprintf_P(fp, PSTR("\n"));
+	}
+}
+#endif
+
+
+//
+// choose how the display is scanned: SCAN_10PHASE (the default) or SCAN_5PHASE.
+//	SCAN_5PHASE lights red and green columns together where it can, which doubles the
+//	LED on time (brightness), with half the display interrupts per cycle.
+//	either way, a display cycle is the same length, so swapinterval() timing doesn't change.
+//
+void setscanmode(uint8_t mode)
+{
+	uint8_t sreg;
+
+	sreg = SREG;
+	cli();
+
+	columns_off();
+	ScanMode = (mode == SCAN_5PHASE) ? SCAN_5PHASE : SCAN_10PHASE;
+	ScanHalf = 0;
+	CurRow = 0;
+	Rcount = 1;				// start the new scan on the next tick
+
+	SREG = sreg;
+}
+
+
+//
+// set the display brightness, from 0 (off) to 255 (full - the default).
+//	each row is lit for only part of its scan phase, and blanked for the rest, so the
+//	refresh rate (and swapinterval timing) stays the same - only the LED current goes down.
+//	there are ROW_TICKS+1 (21) actual steps, so nearby values may look the same.
+//
+void setbrightness(uint8_t b)
+{
+	uint8_t sreg;
+
+	sreg = SREG;
+	cli();
+
+	Brightness = b;
+	OnTicks = ((uint16_t)ROW_TICKS * (b + 1)) >> 8;
+	OnTicks2 = ((uint16_t)2*ROW_TICKS * (b + 1)) >> 8;
+
+	SREG = sreg;
+}
+
+
+uint8_t getbrightness(void)
+{
+	return Brightness;
+}
+
+
 void cleardisplay(void)
 {
 	uint8_t i;
 
 	// initialize display buffer
 
-	for (i = 0; i < 10; i++) {
+	for (i = 0; i < DISPROWS; i++) {
 		Disp[i] = 0x0;
 	}
+	LAT_DIRTY();
 
 	//CurRow = 0;			// XXX needed??
 
@@ -617,29 +1668,130 @@ uint8_t getcolor(void)
 	return _CurColor;
 }
 
+//
+// set the draw mode (DM_SET, DM_OR, DM_XOR or DM_ANDNOT) used by drawpoint and drawfilledrect.
+//
+//	DM_SET replaces pixels with the current color (the default).
+//	the others only touch the color planes that are on in the current color, so for example
+//	drawing twice in DM_XOR erases what was drawn, and DM_ANDNOT with YELLOW erases to black.
+//
+void setdrawmode(uint8_t mode)
+{
+	_DrawMode = 0x3 & mode;
+}
+
+
+//
+// get the current draw mode (returns it).
+//
+uint8_t getdrawmode(void)
+{
+	return _DrawMode;
+}
+
+
+//
+// pick where drawpoint and drawfilledrect draw: LAYER_MAIN (Disp) or LAYER_OVERLAY.
+//
+// note: the text, scroll and animation functions always work on LAYER_MAIN.
+//
+void setdrawlayer(uint8_t layer)
+{
+	if (layer == LAYER_OVERLAY) {
+		_DrawBuf = Overlay;
+	} else {
+		_DrawBuf = Disp;
+	}
+}
+
+
+//
+// turn the overlay on (1) or off (0).  while on, lit overlay pixels are shown instead of
+//	the ones in the main display buffer.  (the ISR does this as it scans each row.)
+//
+void setoverlay(uint8_t on)
+{
+	OverlayFlag = on ? 1 : 0;
+	LAT_DIRTY();
+}
+
+
+void clearoverlay(void)
+{
+	uint8_t i;
+
+	for (i = 0; i < DISPROWS; i++) {
+		Overlay[i] = 0x0;
+	}
+	LAT_DIRTY();
+}
+
+
+//
+// apply the current color and draw mode to the pixels in bits, on row y of both planes.
+//
+static void plotrow(uint8_t y, disprow_t bits)
+{
+	volatile disprow_t *g = &_DrawBuf[y];			// green plane
+	volatile disprow_t *r = &_DrawBuf[y+YSCREEN];	// red plane
+
+	LAT_DIRTY();
+
+	switch (_DrawMode) {
+		case DM_SET:
+			if (_CurColor & 0x1) {
+				*r |= bits;
+			} else {
+				*r &= ~bits;
+			}
+			if (_CurColor & 0x2) {
+				*g |= bits;
+			} else {
+				*g &= ~bits;
+			}
+			break;
+
+		case DM_OR:
+			if (_CurColor & 0x1) {
+				*r |= bits;
+			}
+			if (_CurColor & 0x2) {
+				*g |= bits;
+			}
+			break;
+
+		case DM_XOR:
+			if (_CurColor & 0x1) {
+				*r ^= bits;
+			}
+			if (_CurColor & 0x2) {
+				*g ^= bits;
+			}
+			break;
+
+		case DM_ANDNOT:
+			if (_CurColor & 0x1) {
+				*r &= ~bits;
+			}
+			if (_CurColor & 0x2) {
+				*g &= ~bits;
+			}
+			break;
+	}
+}
+
+
 //
 // draw a point (single pixel) at coordinates (x y),
-//	using the current color.
+//	using the current color and draw mode.
 //
 //	note: upper left is (0 0) and lower right is (6 4)
 //
 //
 void drawpoint(uint8_t x, uint8_t y)
 {
-	uint8_t bits;
-
-	if ((x < 7) && (y < 5)) {	// clipping
-		bits = 0x40 >> x;
-		if (_CurColor & 0x1) {	// red plane
-			Disp[y+5] |= bits;
-		} else {
-			Disp[y+5] &= ~bits;
-		}
-		if (_CurColor & 0x2) {	// green plane
-			Disp[y] |= bits;
-		} else {
-			Disp[y] &= ~bits;
-		}
+	if ((x < XSCREEN) && (y < YSCREEN)) {	// clipping
+		plotrow(y, XBIT(x));
 	}
 }
 
@@ -647,14 +1799,14 @@ void drawpoint(uint8_t x, uint8_t y)
 //
 //	draw a filled rectangle from (x1 y1) to (x2 y2)
 //
-//	XXX probably could be optimized more
+//	note: each row of the rectangle is drawn as one mask.
 //
 void drawfilledrect(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2)
 {
-	uint8_t bits;
-	uint8_t x, y, tmp;
+	disprow_t bits;
+	uint8_t y, tmp;
 
-	if ((x1 < 7) && (y1 < 5) && (x2 < 7) && (y2 < 5)) {	// clipping
+	if ((x1 < XSCREEN) && (y1 < YSCREEN) && (x2 < XSCREEN) && (y2 < YSCREEN)) {	// clipping
 		if (x1 > x2) {
 			tmp = x1;
 			x1 = x2;
@@ -665,22 +1817,203 @@ void drawfilledrect(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2)
 			y1 = y2;
 			y2 = tmp;
 		}
+		bits = (ROWBITS >> x1) & (disprow_t)(ROWBITS << (XSCREEN-1 - x2));	// pixels x1 to x2
 		for (y = y1; y <= y2; y++) {
-			for (x = x1; x <= x2; x++) {
-				bits = 0x40 >> x;
-				if (_CurColor & 0x1) {	// red plane
-					Disp[y+5] |= bits;
-				} else {
-					Disp[y+5] &= ~bits;
-				}
-				if (_CurColor & 0x2) {	// green plane
-					Disp[y] |= bits;
-				} else {
-					Disp[y] &= ~bits;
-				}
-			}
+			plotrow(y, bits);
+		}
+	}
+}
+
+
+//
+// shift one display row (either plane) by dx pixels.
+//	positive dx moves pixels right, negative moves them left.
+//	uncovered pixels are set from fillbits (either 0 or ROWBITS).
+//
+static disprow_t shiftrow(disprow_t row, int8_t dx, disprow_t fillbits)
+{
+	uint8_t n;
+
+	if (dx >= 0) {
+		n = dx;
+		if (n >= XSCREEN) {
+			return fillbits;
+		}
+		return (row >> n) | (fillbits & ~(ROWBITS >> n));
+	} else {
+		n = -dx;
+		if (n >= XSCREEN) {
+			return fillbits;
+		}
+		return ((row << n) & ROWBITS) | (fillbits & ((1 << n) - 1));
+	}
+}
+
+
+//
+// scroll the whole display by (dx dy) pixels.
+//	positive dx moves the picture right, positive dy moves it down.
+//	pixels that scroll off the edge are lost, and uncovered pixels are set to color fill.
+//
+void scroll(int8_t dx, int8_t dy, uint8_t fill)
+{
+	uint8_t y;
+	int16_t src;			// (y - dy doesn't fit in 8 bits)
+	disprow_t gfill, rfill;
+
+	gfill = (fill & 0x2) ? ROWBITS : 0;	// green plane
+	rfill = (fill & 0x1) ? ROWBITS : 0;	// red plane
+	LAT_DIRTY();
+
+	if (dx != 0) {
+		for (y = 0; y < YSCREEN; y++) {
+			Disp[y] = shiftrow(Disp[y], dx, gfill);
+			Disp[y+YSCREEN] = shiftrow(Disp[y+YSCREEN], dx, rfill);
+		}
+	}
+
+	if (dy > 0) {
+		for (y = YSCREEN; y-- > 0; ) {		// bottom up, so we don't overwrite rows we still need
+			src = y - dy;
+			Disp[y] = (src >= 0) ? Disp[src] : gfill;
+			Disp[y+YSCREEN] = (src >= 0) ? Disp[src+YSCREEN] : rfill;
+		}
+	} else if (dy < 0) {
+		for (y = 0; y < YSCREEN; y++) {
+			src = y - dy;
+			Disp[y] = (src < YSCREEN) ? Disp[src] : gfill;
+			Disp[y+YSCREEN] = (src < YSCREEN) ? Disp[src+YSCREEN] : rfill;
+		}
+	}
+}
+
+
+//
+// scroll the whole display by (dx dy) pixels, wrapping around the edges.
+//
+void scroll_wrap(int8_t dx, int8_t dy)
+{
+	uint8_t y, n;
+	disprow_t g, r;
+
+	LAT_DIRTY();
+
+	// convert to a move right (and a move down), 0..XSCREEN-1 (and 0..YSCREEN-1)
+	while (dx < 0) {
+		dx += XSCREEN;
+	}
+	while (dy < 0) {
+		dy += YSCREEN;
+	}
+	n = dx % XSCREEN;
+
+	if (n != 0) {
+		for (y = 0; y < YSCREEN; y++) {
+			Disp[y] = ((Disp[y] >> n) | (Disp[y] << (XSCREEN - n))) & ROWBITS;
+			Disp[y+YSCREEN] = ((Disp[y+YSCREEN] >> n) | (Disp[y+YSCREEN] << (XSCREEN - n))) & ROWBITS;
 		}
 	}
+
+	// rotate rows down, one at a time (at most 4 times)
+	for (n = dy % YSCREEN; n != 0; n--) {
+		g = Disp[YSCREEN-1];
+		r = Disp[YSCREEN-1+YSCREEN];
+		for (y = YSCREEN-1; y > 0; y--) {
+			Disp[y] = Disp[y-1];
+			Disp[y+YSCREEN] = Disp[y-1+YSCREEN];
+		}
+		Disp[0] = g;
+		Disp[YSCREEN] = r;
+	}
+}
+
+
+//
+// shift the display left by one column, and fill the rightmost column from bits
+//	(bit 0 is the top pixel) using color c.  other pixels of that column are cleared.
+//
+// (internal version of shift_in_column, also used by the text scroller in the ISR)
+//
+void _shiftcolumn(dispcol_t bits, uint8_t c)
+{
+	uint8_t y;
+	disprow_t bit;
+
+	LAT_DIRTY();
+
+	for (y = 0; y < YSCREEN; y++) {
+		bit = bits & 0x1;
+		bits >>= 1;
+		Disp[y] = ((Disp[y] << 1) & ROWBITS) | ((c & 0x2) ? bit : 0);					// green plane
+		Disp[y+YSCREEN] = ((Disp[y+YSCREEN] << 1) & ROWBITS) | ((c & 0x1) ? bit : 0);	// red plane
+	}
+}
+
+
+//
+// shift the display left by one column, and fill the rightmost column from bits
+//	(bit 0 is the top pixel) using the current color.  handy for marquees.
+//
+void shift_in_column(dispcol_t bits)
+{
+	_shiftcolumn(bits, _CurColor);
+}
+
+
+// a simple animation player.
+
+//
+// play an animation, that is, a sequence of keyframes (in program memory).
+// each keyframe is a duration in frames (see swapinterval), followed by the display buffer
+// rows (5 green rows, then 5 red rows - DISPROWS in all, each one sizeof(disprow_t) bytes).
+// the sequence must end with the byte A_END, or A_LOOP to start over.
+//
+// like playsong(), this returns right away - the display ISR steps through the keyframes.
+//
+// note: don't draw on the main layer while an animation is playing (the overlay is ok).
+//
+void playanim(const uint8_t *anim)
+{
+	if (anim == NULL) {				// error check
+		return;
+	}
+
+	AnimPlayFlag = 0;				// just in case an animation is currently playing
+
+	AnimStart = anim;
+	AnimPtr = anim;
+	AnimCount = 1;					// first keyframe appears on the next frame
+
+	AnimPlayFlag = 1;
+}
+
+
+//
+// stop the current animation (whatever keyframe is showing stays on the display)
+//
+void stopanim(void)
+{
+	AnimPlayFlag = 0;
+}
+
+
+//
+// this returns 1 if an animation is playing, 0 otherwise.
+//
+uint8_t isanimplaying(void)
+{
+	return AnimPlayFlag;
+}
+
+
+//
+// this waits until the animation is finished, then returns.
+//
+void waitanim(void)
+{
+	while (AnimPlayFlag) {
+		_idle();
+	}
 }
 
 
@@ -692,7 +2025,7 @@ void initaudio(void)
 	wavPtr = SawWtable;
 	
 	// default tempo
-	//XXX
+	settempo(DEFAULTTEMPO);
 	
 	SongPlayFlag = 0;
 	PWMval = wavPtr[0];		// initialize to first entry of table
@@ -700,12 +2033,23 @@ void initaudio(void)
 
 
 //
-// sets tempo for playnote function.
-// the default tempo is 72 beats per minute.
+// sets tempo for playnote and playsong.  it takes effect from the next note.
+// the default tempo is 120 beats per minute.  under MINTEMPO is played at MINTEMPO.
 //
 void settempo(byte bpm)
 {
-	// XXX NYI !!
+	uint16_t unit;
+	uint8_t sreg;
+
+	if (bpm < MINTEMPO) {
+		bpm = MINTEMPO;
+	}
+	unit = DURUNIT(bpm);		// (a division - but only here, not for every note)
+
+	sreg = SREG;
+	cli();						// the ISR reads DurUnit
+	DurUnit = unit;
+	SREG = sreg;
 }
 
 
@@ -816,32 +2160,14 @@ R2N5(2.000),	// N_C6	- C6 (2 octaves above middle C)
 
 
 //
-// this table converts duration values (1..48) into the
-// actual number of ticks used by the audio code.
-// the table is loaded for a specific tempo (e.g. 75 bpm - beats [aka quarter note] per minute).
+// durations: a duration value (1..48) is in units of 1/12 beat, and GETDURATION() turns it
+// into ticks used by the audio code, by multiplying it by DurUnit (ticks per unit, which
+// settempo sets).  at the slowest tempo (MINTEMPO), 48 units still fit in 16 bits.
 //
 // design note:
 //	by using 48 values, instead of a power of two like 16, we can represent triplets.
 //	a quarter note (1 beat) is 12, an eighth note is 6, and an 8th triplet is 4.
 //
-//
-// note: remember to subtract 1 before indexing this table with a standard duration (1..48)
-//
-// XXX need to fill in ALL entries in this table! (just did the common ones)
-//
-// also see GETDURATION() macro which references DurTab.
-//
-uint16_t DurTab[48] = {
-0,0,TEMPOBEAT/4,TEMPOBEAT/3,0,TEMPOBEAT/2,
-0,0,0,0,0,TEMPOBEAT,
-0,0,0,0,0,0,
-0,0,0,0,0,TEMPOBEAT*2,
-
-0,0,0,0,0,0,
-0,0,0,0,0,TEMPOBEAT*3,
-0,0,0,0,0,0,
-0,0,0,0,0,TEMPOBEAT*4,
-};
 
 
 //
@@ -878,6 +2204,14 @@ void playsong(byte *songtable)
 		WtabCount.integ = 0;				// we will start playing from start of current wavetable
 		WtabCount.fract = 0;
 		PWMval = wavPtr[0];					// initialize to first entry of table
+#ifdef MIGGL_LATENCY
+		if (LatWait & LAT_WAITPLAY) {		// time this song's first sample
+			uint8_t sreg = SREG;
+			cli();
+			LatWait = (LatWait & ~LAT_WAITPLAY) | LAT_WAITAUDIO;
+			SREG = sreg;
+		}
+#endif
 		SongPlayFlag = 1;					// start playing song
 	}
 }
@@ -898,7 +2232,7 @@ byte isaudioplaying(void)
 void waitaudio(void)
 {
 	while (SongPlayFlag) {
-		NOP();
+		_idle();
 	}
 	
 	return;
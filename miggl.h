@@ -9,6 +9,81 @@
  *
  *	revision history:
  *
+ *	- oct 18, 2026 - jesse
+ *		gettaskstats() and resettaskstats() are only there with -DMIGGL_TASKSTATS.
+ *
+ *	- oct 18, 2026 - jesse
+ *		the session functions are only built with -DMIGGL_SESSION.  without it, they're
+ *		stand-ins: getsession() is always SES_OFF, and startsession() returns the seed.
+ *
+ *	- oct 18, 2026 - jesse
+ *		savesession() returns whether it's saving the recording.
+ *
+ *	- oct 18, 2026 - jesse
+ *		taskstats.runs is 32 bits.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add miggl_init() and the main loop, miggl_run(), with callbacks (miggl_onframe, etc)
+ *		and task statistics (see miggl-run.c).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add gettick32(), and software timers and delays (starttimer, delayms, etc - see miggl-timer.c).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add the link between two boards (linkinit, linksend, linkrecv, etc - see miggl-link.c).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add TICKHZ (the ISR rate - it can be changed at compile time, e.g. for the host simulator).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add nvload(), nvsave(), nvbusy() and NV_MAXDATA (see miggl-nv.c).
+ *
+ *	- oct 18, 2026 - jesse
+ *		settempo() works now (74 to 255 bpm).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add seedinit(), getseed(), getseedcost() (see miggl-seed.c).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add session record/replay (setsession, startsession, etc - see miggl-session.c).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add gesture events (BE_TAP, BE_LONG, BE_REPEAT, BE_CHORD) and setgestures().
+ *
+ *	- oct 18, 2026 - jesse
+ *		add latency counters (struct latencystats, getlatency, etc) for -DMIGGL_LATENCY builds.
+ *
+ *	- oct 18, 2026 - jesse
+ *		add input modes (INPUT_POLL, INPUT_PCINT) and sleepuntilbutton().
+ *
+ *	- oct 18, 2026 - jesse
+ *		add button masks (BTN_A, etc), struct buttonevent, getbuttons(), getbuttonevent().
+ *
+ *	- oct 18, 2026 - jesse
+ *		add setbrightness(), getbrightness().
+ *
+ *	- oct 18, 2026 - jesse
+ *		display size can be set at compile time (XSCREEN, YSCREEN).  add disprow_t, dispcol_t,
+ *		DISPROWS, ROWBITS and XBIT().
+ *
+ *	- oct 18, 2026 - jesse
+ *		add animation functions (playanim, etc).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add timing functions (gettick, getframestats, etc).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add scan modes (SCAN_10PHASE, SCAN_5PHASE).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add draw modes (DM_SET, etc) and layers (LAYER_MAIN, LAYER_OVERLAY).
+ *
+ *	- oct 18, 2026 - jesse
+ *		add scroll(), scroll_wrap() and shift_in_column().
+ *
+ *	- oct 18, 2026 - jesse
+ *		add text functions (see miggl-text.c).  declare getcolor().
+ *
  *	- may 24, 2008 - rolf
  *		move MIN_NOTE constant to here.
  *
@@ -44,9 +119,58 @@
 #define GREEN	2
 #define YELLOW	3
 
-/* display size (in pixels) */
+/* draw modes - used with setdrawmode() */
+#define DM_SET		0
+#define DM_OR		1
+#define DM_XOR		2
+#define DM_ANDNOT	3
+
+/* layers - used with setdrawlayer() */
+#define LAYER_MAIN		0
+#define LAYER_OVERLAY	1
+
+/* scan modes - used with setscanmode() */
+#define SCAN_10PHASE	0		// one phase per display buffer row (green rows, then red rows)
+#define SCAN_5PHASE		1		// one phase per display line (green and red together)
+
+/* display size (in pixels) - may be overridden on the compiler command line (e.g. -DXSCREEN=8) */
+/* note: the column pins in iodefs.h (DISP_GREENCOLS, DISP_REDCOLS) must match YSCREEN */
+#ifndef XSCREEN
 #define XSCREEN 7
+#endif
+#ifndef YSCREEN
 #define YSCREEN 5
+#endif
+
+/* one display buffer row holds XSCREEN pixels, right-justified (x = 0 is the highest bit) */
+#if XSCREEN <= 8
+typedef uint8_t disprow_t;
+#elif XSCREEN <= 16
+typedef uint16_t disprow_t;
+#else
+#error "XSCREEN must be 16 or less"
+#endif
+
+/* one display column holds YSCREEN pixels (bit 0 = top) - see shift_in_column() */
+#if YSCREEN <= 8
+typedef uint8_t dispcol_t;
+#elif YSCREEN <= 16
+typedef uint16_t dispcol_t;
+#else
+#error "YSCREEN must be 16 or less"
+#endif
+
+#define DISPROWS	(2*YSCREEN)					// display buffer rows (green plane, then red plane)
+#define ROWBITS		((disprow_t)((1UL << XSCREEN) - 1))	// all pixels of a row
+#define XBIT0		((disprow_t)(1U << (XSCREEN-1)))	// pixel x = 0 of a row
+#define XBIT(x)		(XBIT0 >> (x))					// pixel x of a row
+
+/* ISR (timer1 overflow) rate - may be overridden on the compiler command line (e.g. -DTICKHZ=1000) */
+/* note: a multiple of 1000, up to 20000.  the notes and wave tables are only right at 20000 (the */
+/* host simulator, which has no sound, runs slower to save time) */
+#ifndef TICKHZ
+#define TICKHZ	20000
+#endif
 
 /* notes (incomplete!) */
 #define N_END	0
@@ -106,6 +230,11 @@
 #define N_8TH_TRIP 	4
 
 
+/* animation keyframe durations with special meaning - used in playanim() sequences */
+#define A_END	0
+#define A_LOOP	255
+
+
 /* wavetable choices - used with setwavetable() */
 #define WT_SAWTOOTH		1
 #define WT_SINE			2
@@ -122,8 +251,68 @@ extern byte ButtonBEvent;
 extern byte ButtonCEvent;
 extern byte ButtonDEvent;
 
+/* press-to-feedback latency counters - see getlatency() (only with -DMIGGL_LATENCY) */
+#define LAT_DISPLAY		0		// button press to the first frame showing a change
+#define LAT_AUDIO		1		// button press to the first audio sample
+#define LAT_BUCKETS		8		// histogram: under 1ms, under 2ms, under 4ms, ... 64ms and over
+
+struct latencystats {
+	uint16_t count;
+	uint16_t min;			// in ISR ticks (1/TICKHZ s)
+	uint16_t max;
+	uint32_t sum;			// (avg is sum / count)
+	uint16_t hist[LAT_BUCKETS];
+};
+
+/* button masks - used with getbuttons() and struct buttonevent */
+#define BTN_A		0x1		// SW1
+#define BTN_B		0x2		// SW2
+#define BTN_C		0x4		// SW3
+#define BTN_D		0x8		// SW4
+
+/* input modes - used with setinputmode() */
+#define INPUT_POLL	0		// sampled and debounced in the display ISR
+#define INPUT_PCINT	1		// pin change interrupts
+
+/* button event types */
+#define BE_RELEASE	0
+#define BE_PRESS	1
+#define BE_TAP		2		// press and release (not long)
+#define BE_LONG		3		// held for a while (still down)
+#define BE_REPEAT	4		// auto-repeat while held
+#define BE_CHORD	5		// buttons pressed together (button is a mask of them all)
+
+/* gesture masks - used with setgestures() */
+#define GE_RELEASE	(1 << BE_RELEASE)
+#define GE_PRESS	(1 << BE_PRESS)
+#define GE_TAP		(1 << BE_TAP)
+#define GE_LONG		(1 << BE_LONG)
+#define GE_REPEAT	(1 << BE_REPEAT)
+#define GE_CHORD	(1 << BE_CHORD)
+
+/* button event - see getbuttonevent() */
+struct buttonevent {
+	uint8_t button;			// BTN_A, etc
+	uint8_t type;			// BE_PRESS, etc
+	uint16_t tick;			// when it happened (see gettick), after debouncing
+};
+
 
-extern volatile uint8_t Disp[];		// XXX probably shouldn't access this!
+/* session modes - used with setsession() */
+#define SES_OFF		0
+#define SES_RECORD	1
+#define SES_REPLAY	2
+
+/* frame timing statistics - see getframestats() */
+struct framestats {
+	uint16_t presented;		// frames flipped by swapbuffers()
+	uint16_t missed;		// frames the main loop was too late to flip
+	uint16_t worst;			// longest main loop time (swapbuffers to swapbuffers), in ms
+	uint16_t last;			// main loop time of the last frame, in ms
+};
+
+
+extern volatile disprow_t Disp[];		// XXX probably shouldn't access this!
 
 
 /* graphics functions */
@@ -131,10 +320,96 @@ extern volatile uint8_t Disp[];		// XXX probably shouldn't access this!
 void swapbuffers(void);
 void initswapbuffers(void);
 void swapinterval(uint8_t i);
+void setscanmode(uint8_t mode);
+void setbrightness(uint8_t b);		// 0 (off) to 255 (full)
+uint8_t getbrightness(void);
 void cleardisplay(void);
 void setcolor(uint8_t c);
+uint8_t getcolor(void);
+void setdrawmode(uint8_t mode);
+uint8_t getdrawmode(void);
+void setdrawlayer(uint8_t layer);
+void setoverlay(uint8_t on);		// 1 shows the overlay on top of the main layer
+void clearoverlay(void);
 void drawpoint(uint8_t x, uint8_t y);
 void drawfilledrect(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2);
+void scroll(int8_t dx, int8_t dy, uint8_t fill);	// uncovered pixels are set to color fill
+void scroll_wrap(int8_t dx, int8_t dy);
+void shift_in_column(dispcol_t bits);		// shifts left, bits (bit 0 = top) go in the right column
+
+
+/* timing functions */
+
+uint16_t gettick(void);				// milliseconds since start_timer1() (wraps)
+uint32_t gettick32(void);			// the same, 32 bits
+void getframestats(struct framestats *fs);
+void resetframestats(void);
+void dumpframestats(FILE *fp);		// note: needs <stdio.h>
+#ifdef MIGGL_LATENCY
+void getlatency(uint8_t which, struct latencystats *ls);	// which is LAT_DISPLAY or LAT_AUDIO
+void resetlatency(void);
+void dumplatency(FILE *fp);			// note: needs <stdio.h>
+#endif
+
+
+/* software timer functions (see miggl-timer.c) */
+
+#define MAXTIMERS		4			// timers 0 to 3
+
+void starttimer(uint8_t n, uint16_t ms, uint16_t period);	// period 0 goes off once
+void stoptimer(uint8_t n);
+uint8_t timerexpired(uint8_t n);	// times it has gone off since the last call
+uint8_t gettimers(void);			// the ones that have gone off (bit n for timer n)
+uint16_t timerleft(uint8_t n);		// ms until it goes off
+void waittimer(uint8_t n);			// waits until it goes off
+void delayms(uint16_t ms);			// waits ms milliseconds
+
+
+/* start up and main loop functions (see miggl-run.c) */
+
+#define TASK_FRAME		0			// tasks, for gettaskstats()
+#define TASK_BUTTON		1
+#define TASK_TIMER		2			// TASK_TIMER + n is timer n's
+#define TASK_IDLE		(TASK_TIMER + MAXTIMERS)	// (waiting for something to do)
+#define NTASKS			(TASK_IDLE + 1)
+
+/* main loop task statistics - see gettaskstats() (only with -DMIGGL_TASKSTATS) */
+struct taskstats {
+	uint32_t runs;			// (TASK_IDLE runs every ISR tick or so - 16 bits would wrap in seconds)
+	uint16_t max;			// longest run, in ISR ticks (1/TICKHZ s)
+	uint32_t sum;			// all runs (avg is sum / runs)
+};
+
+void miggl_init(void);							// avrinit(), start_timer1(), etc
+void miggl_onframe(void (*fn)(void));			// called once a frame (after the swap)
+void miggl_onbutton(void (*fn)(struct buttonevent *ev));	// called for each button event
+void miggl_ontimer(uint8_t n, void (*fn)(void));	// called when timer n goes off
+void miggl_run(void);							// calls them - never returns
+#ifdef MIGGL_TASKSTATS
+void gettaskstats(uint8_t task, struct taskstats *ts);
+void resettaskstats(void);
+#endif
+
+
+/* text functions */
+
+void drawchar(uint8_t x, char c);
+void scrolltext(const char *s);
+void scrolltext_P(const char *s);	// string is in program memory
+void scrollnumber(uint16_t n);
+void settextspeed(uint8_t frames);	// frames per column (default 1)
+
+uint8_t istextscrolling(void);		// returns 1 if text is scrolling, 0 otherwise
+void waittext(void);				// waits until text has scrolled off the display
+
+
+/* animation functions */
+
+void playanim(const uint8_t *anim);		// anim is in program memory
+void stopanim(void);
+
+uint8_t isanimplaying(void);		// returns 1 if an animation is playing, 0 otherwise
+void waitanim(void);				// waits until the animation is finished
 
 
 /* button functions */
@@ -142,6 +417,74 @@ void drawfilledrect(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2);
 void button_init(void);
 void poll_buttons(void);
 void handlebuttons(void);
+uint8_t getbuttons(void);						// debounced state (BTN_A, etc)
+uint8_t getbuttonevent(struct buttonevent *ev);	// returns 0 if there are no events
+void flushbuttonevents(void);
+void setgestures(uint8_t mask);					// events getbuttonevent returns (GE_PRESS, etc)
+void setinputmode(uint8_t mode);
+uint8_t getinputmode(void);
+void sleepuntilbutton(void);					// power down (display off) until a button is pressed
+
+
+/* session functions (see miggl-session.c - only with -DMIGGL_SESSION, the rest are stand-ins) */
+
+#ifdef MIGGL_SESSION
+void setsession(uint8_t mode, uint8_t *buf, uint16_t size);	// what the next startsession() does
+uint8_t getsession(void);
+uint16_t startsession(uint16_t seed);		// returns the seed to use (the recorded one, for a replay)
+uint16_t endsession(void);					// returns the length of the recording
+uint8_t savesession(void);					// ends the session, and saves its recording in EEPROM (0 if it can't)
+uint16_t loadsession(uint8_t *buf, uint16_t size);	// returns the length, 0 if no recording
+#else
+#define setsession(mode, buf, size)	((void)0)
+#define getsession()				SES_OFF
+#define startsession(seed)			(seed)
+#define endsession()				0
+#define savesession()				0
+#define loadsession(buf, size)		0
+#endif
+
+
+/* saved data functions (see miggl-nv.c) */
+
+#define NV_MAXDATA		30			// biggest record nvsave() can keep
+
+uint8_t nvload(void *data, uint8_t size);		// returns 0 if nothing was saved
+uint8_t nvsave(const void *data, uint8_t size);	// returns 0 if busy (the last save is still being written)
+uint8_t nvbusy(void);							// returns 1 while saving (nvsave, savesession)
+
+
+/* link functions (two boards, over the UART - see miggl-link.c) */
+
+#define LINK_MAXDATA	6			// most data bytes in a message
+
+struct linkmsg {
+	uint8_t type;					// 0 to 7
+	uint8_t len;					// bytes of data
+	uint8_t data[LINK_MAXDATA];
+};
+
+struct linkstats {
+	uint16_t sent;					// messages sent
+	uint16_t resent;				// frames sent again
+	uint16_t received;				// messages received
+	uint16_t crcerrors;				// bad or broken frames
+	uint16_t restarts;				// times the other board started (or restarted)
+};
+
+void linkinit(void);							// starts the UART (see uart.h for the baud rate)
+uint8_t islinkon(void);
+uint8_t linksend(uint8_t type, const void *data, uint8_t len);	// returns 0 if busy (try again)
+uint8_t linkrecv(struct linkmsg *m);			// returns 0 if there are no messages
+uint8_t linkpeer(void);							// returns 1 if the other board is there
+void getlinkstats(struct linkstats *ls);
+
+
+/* random seed functions (see miggl-seed.c) */
+
+void seedinit(void);				// call once, after start_timer1()
+uint16_t getseed(void);				// never 0
+uint16_t getseedcost(void);			// seedinit() time, in microseconds
 
 
 /* audio functions */
@@ -150,7 +493,7 @@ void initaudio(void);
 
 //void playsound(int pitch, int dur);
 
-void settempo(byte bpm);
+void settempo(byte bpm);		// beats (quarter notes) per minute, 74 to 255 (default 120)
 void setwavetable(byte wtable);
 void playnote(byte note, byte dur);
 void playsong(byte *songtable);
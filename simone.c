@@ -16,9 +16,100 @@
  *
  *	instructions:
  *		Based upon Simon. Hit the correct buttons based upon the arrows displayed
+ *		A button pressed before the first arrow (or the one that starts a new game) picks
+ *		the speed: SW2 is relaxed, SW3 is fast, the others are normal.  It speeds up every level.
+ *		Holding SW2 and SW3 at power up plays against another board, plugged into the serial
+ *		port: both play the same arrows, and the higher level wins.
  *
  *	revision history:
  *
+ *  - Oct 18, 2026 - jesse
+ *      in linked play, the UART has the two right hand columns (see iodefs.h), so the
+ *      arrows, the intro and the score are drawn in the left five (screenWidth).
+ *
+ *  - Oct 18, 2026 - jesse
+ *      game recording (and the replay buttons) only with -DMIGGL_SESSION, and SessionBuf is
+ *      96 bytes - there isn't the RAM for it otherwise.
+ *
+ *  - Oct 18, 2026 - jesse
+ *      the intro animation and the scrolling score are timed in ms (MS_FRAMES), so they run
+ *      at their old speed with the 20ms frame, instead of 5 times faster.
+ *
+ *  - Oct 18, 2026 - jesse
+ *      start up with miggl_init(), and run the game from miggl_run(): step_game is the
+ *      frame callback, and end_flash the flash timer's.
+ *
+ *  - Oct 18, 2026 - jesse
+ *      the feedback flash is turned off by a miggl one-shot timer (see miggl-timer.c).
+ *
+ *  - Oct 18, 2026 - jesse
+ *      head to head: holding SW2 + SW3 at power up links up with another board over the
+ *      UART (see miggl-link.c).  the boards swap seeds, so they play the same sequence,
+ *      and send each other every press (2 bytes each), so the score screen shows the
+ *      other board's level too, as it plays - green for the winner, red for the loser.
+ *
+ *  - Oct 18, 2026 - jesse
+ *      keep the best score for each mode, and some statistics (games played, games won,
+ *      levels reached), in EEPROM (nvsave - saved in the background, and wear levelled).
+ *      a new best score is shown in yellow; otherwise the score screen takes turns
+ *      showing the score (red) and the best (green).  replayed games don't count.
+ *
+ *  - Oct 18, 2026 - jesse
+ *      difficulty: the playback speeds up every level (tone tempo and the gap between
+ *      arrows), by game mode.  each arrow's tone starts as soon as the last one is done.
+ *
+ *  - Oct 18, 2026 - jesse
+ *      the random number generator is xorshift16 now, with a mask-and-reject range
+ *      (random_below) - no division, and no bias.
+ *
+ *  - Oct 18, 2026 - jesse
+ *      init_random() no longer sums all of data space (slow, and it read I/O registers) -
+ *      each game is seeded from getseed() (see miggl-seed.c) when it starts.
+ *
+ *  - Oct 18, 2026 - jesse
+ *      the arrow sequence isn't stored any more - it's regenerated from the game's seed
+ *      (seq_reset/seq_next) for each playback and check, so the history RAM is free, and
+ *      the game goes on up to level 65535.
+ *
+ *  - Oct 18, 2026 - jesse
+ *      the arrow history is packed 4 to a byte, in all of the free RAM, so the game goes
+ *      to thousands of levels instead of 99.  the level is a uint16_t now.
+ *
+ *  - Oct 18, 2026 - jesse
+ *      the game is a state machine now (intro, playback, input, level up, game over, win,
+ *      score), stepped once per frame - no more delay loops, so the CPU sleeps between
+ *      frames.  any button on the score screen starts a new game.
+ *      removed the delay_us/delay_ms/delay_sec busy waits (nothing uses them now).
+ *
+ *  - Oct 18, 2026 - jesse
+ *      record every game (seed and button events) with the miggl session recorder, and save
+ *      it to EEPROM at the end.  holding the top left and bottom right buttons (SW1 + SW4)
+ *      at power up replays the saved game.
+ *
+ *  - Oct 18, 2026 - jesse
+ *      read the buttons as press events (getbuttonevent) instead of the btnDown latch.
+ *
+ *  - Oct 18, 2026 - jesse
+ *      use pin change interrupts for the buttons.  the final score screen powers down
+ *      after a minute, and wakes up on any button.
+ *
+ *  - Oct 18, 2026 - jesse
+ *      dim the display when waiting a long time for input, and on the final score screen.
+ *
+ *  - Oct 18, 2026 - jesse
+ *      init_random() skips the SRAM walk in the host build (see host/termview.c).
+ *
+ *  - Oct 18, 2026 - jesse
+ *      the startup screen is a miggl animation now, and any button skips it.
+ *
+ *  - Oct 18, 2026 - jesse
+ *      button feedback arrows are XOR'd on and off (flash_arrow), so the input loop
+ *      no longer clears the whole display on every pass.
+ *
+ *  - Oct 18, 2026 - jesse
+ *      draw the score with the miggl font (drawchar) instead of the digit segment helpers.
+ *      scores above 99 scroll across the display.
+ *
  *  - Feb 16, 2010 - jesse
  *      cleaning up code for "official" release
  *
@@ -40,10 +131,7 @@
 #include <stdlib.h>			// for abs(), etc.
 //#include <string.h>			// for strcpy, etc.
 
-#include "uart.h"			// we keep this here only to define F_CPU (uart.c not needed)
-
-// for _delay_us() macro  (note: this gets F_CPU define from uart.h)
-#include <util/delay.h>
+#include "uart.h"			// for F_CPU (uart.c is used by the link - see miggl-link.c)
 
 #include "mydefs.h"
 #include "iodefs.h"
@@ -52,71 +140,71 @@
 
 
 
-//=============================================================
-// Time functions by Rolf Van Widenfelt & Mitch Altman (munch)
-//=============================================================
+//============================================
+// Random number generator
+//============================================
 
+/*
+ * xorshift16 (shifts 7, 9, 8): goes through all 65535 non-zero states before it repeats.
+ * (0 would stay 0, so it's never used as a state.)
+ *
+ * A range is done by masking to the next power of 2 and trying again if the number is
+ * too big - no division (which avr-gcc does in software), and every result is equally
+ * likely, unlike with %.  At worst (max = 2^n + 1) that's 2 tries per number, on average.
+ *
+ * (this replaces Jegge's generator (Tri2s) - host/rngreport.c compares the two.)
+ */
+static uint16_t RandomState = 0x110D;
 
 /**
- * crude delay of 1 to 255 us
+ * One step of the generator whose state is in *s
  */
-void delay_us(byte usec)
-{
-	usec++;
-	
-	while (--usec) {
-		_delay_us(1);		// get 1us delay from library macro (see <util/delay.h>)
-	}
+uint16_t xorshift16 (uint16_t *s) {
+	uint16_t x = *s;
+
+	x ^= x << 7;
+	x ^= x >> 9;
+	x ^= x << 8;
+	*s = x;
+	return x;
 }
 
-
 /**
- * crude delay of 1 to 255 ms
+ * Returns a pseudo random number from 0 to max-1 (max is 1 to 255), from the generator in *s
  */
-void delay_ms(uint8_t ms) {
-	ms++;
-	
-	while (--ms) {
-		_delay_ms(1);		// get 1ms delay from library macro (see <util/delay.h>)
-	}
+uint8_t random_below (uint16_t *s, uint8_t max) {
+	uint8_t mask, r;
+
+	mask = max - 1;
+	mask |= mask >> 1;
+	mask |= mask >> 2;
+	mask |= mask >> 4;
+	do {
+		r = (xorshift16(s) >> 8) & mask;		//(the high byte is the better mixed one)
+	} while (r >= max);
+	return r;
 }
 
-
 /**
- * crude delay of 1 to 255 s
+ * Generates a pseudo random number from 0 to max-1
  */
-void delay_sec(uint8_t sec) {
-	uint8_t i;
-	for (i = 0; i < sec; i++) {
-		delay_ms(250);
-		delay_ms(250);
-		delay_ms(250);
-		delay_ms(250);
-	}
+uint8_t next_random (uint8_t max) {
+	return random_below(&RandomState, max);
 }
 
+uint16_t get_random_seed (void) {
+	return RandomState;
+}
 
-
-//============================================
-// Random number generator by Jegge (Tri2s)
-//============================================
-
-static uint8_t RandomSeedA = 0x11;
-static uint8_t RandomSeedB = 0x0D;
+void set_random_seed (uint16_t seed) {
+	RandomState = (seed != 0) ? seed : 0x110D;
+}
 
 /**
- * Generates a pseudo random number from 0 to max 
+ * Seeds the generator from the boot entropy (see seedinit), and the button presses so far
  */
-uint8_t next_random (uint8_t max) {
-	RandomSeedA = 0x7F * (RandomSeedA & 0x0F) + (RandomSeedA >> 4);
-	RandomSeedB = 0x3C * (RandomSeedB & 0x0F) + (RandomSeedB >> 4);
- 	return ((RandomSeedA << 4) + RandomSeedB) % max;
-}
-
 void init_random (void) {
-	uint8_t *addr = 0;
-	for (addr = 0; addr < (uint8_t*)0xFFFF; addr++) 
-		RandomSeedB += (*addr);	
+	set_random_seed(getseed());
 }
 
 
@@ -165,6 +253,19 @@ static byte DIRECTION_D_NOISE[] = {N_G4, N_16TH, N_END};
 
 static byte CORRECT_NOISE[] = {N_C5, N_16TH, N_D5, N_16TH, N_E5, N_16TH, N_END};
 
+/* The tone for an arrow in the playback (the note is filled in - see play_arrow_tone) */
+static byte ARROW_TONE[] = {N_C4, N_8TH, N_END};
+
+#define SONG_BPM	120		// tempo of the music (the arrow tones speed up - see arrow_tempo)
+
+/**
+ * Plays a song at the normal tempo
+ */
+void play_music(byte *song) {
+	settempo(SONG_BPM);
+	playsong(song);
+}
+
 
 
 
@@ -186,15 +287,48 @@ static byte DIRECTIONS[4] = {
 	DIRECTION_D
 };
 
-/* Array to hold arrow history */
-static byte arrows[100];
+/*
+ * The arrow sequence.  It's random, but it's only ever added to, so it isn't stored:
+ * it comes from a generator of its own, which starts over from the game's seed
+ * (seq_reset) for every playback and for every check of the player's presses.
+ * That's 4 bytes of RAM, however long the game goes.
+ */
+#define MAX_LEVEL	0xffff		// (the playback alone would take 14 hours)
 
+static uint16_t seqSeed;		// the game's seed
+static uint16_t seqState;		// the generator
 
+/**
+ * Starts a new sequence
+ */
+void seq_init(uint16_t seed) {
+	seqSeed = (seed != 0) ? seed : 0x110D;		//(0 would stay 0 - see xorshift16)
+}
+
+/**
+ * Goes back to the first arrow of the sequence
+ */
+void seq_reset(void) {
+	seqState = seqSeed;
+}
+
+/**
+ * Returns the next arrow of the sequence
+ */
+byte seq_next(void) {
+	return DIRECTIONS[random_below(&seqState, 4)];
+}
+
+
+
+static byte screenWidth = XSCREEN;		// columns we draw in (LINK_XSCREEN in linked play)
 
 /**
  * Displays the arrows on the screen
  */
 void draw_arrow(byte dir, byte clr) {
+	byte r = screenWidth - 1;		// right hand column
+
 	setcolor(clr);
 	if (dir == DIRECTION_A) {
 		//POINTS UP AND LEFT
@@ -224,380 +358,820 @@ void draw_arrow(byte dir, byte clr) {
 	}
 	else if (dir == DIRECTION_C) {
 		//POINTS DOWN AND RIGHT
-		drawpoint(6, 4);
-		drawpoint(6, 3);
-		drawpoint(6, 2);
-		drawpoint(5, 4);
-		drawpoint(4, 4);
-		drawpoint(5, 3);
-		drawpoint(4, 2);
-		drawpoint(3, 1);
-		drawpoint(2, 0);
+		drawpoint(r, 4);
+		drawpoint(r, 3);
+		drawpoint(r, 2);
+		drawpoint(r - 1, 4);
+		drawpoint(r - 2, 4);
+		drawpoint(r - 1, 3);
+		drawpoint(r - 2, 2);
+		drawpoint(r - 3, 1);
+		drawpoint(r - 4, 0);
 		//drawpoint(0, 5);
 
 	}
 	else if (dir == DIRECTION_D) {
 
 		//POINTS UP AND RIGHT
-		drawpoint(6, 0);
-		drawpoint(6, 1);
-		drawpoint(6, 2);
-		drawpoint(5, 0);
-		drawpoint(4, 0);
-		drawpoint(5, 1);
-		drawpoint(4, 2);
-		drawpoint(3, 3);
-		drawpoint(2, 4);
+		drawpoint(r, 0);
+		drawpoint(r, 1);
+		drawpoint(r, 2);
+		drawpoint(r - 1, 0);
+		drawpoint(r - 2, 0);
+		drawpoint(r - 1, 1);
+		drawpoint(r - 2, 2);
+		drawpoint(r - 3, 3);
+		drawpoint(r - 4, 4);
 		//drawpoint(0, 5);
 	}
 }
 
 /**
- * Draws an arrow to the screen and plays the appropriate noise
+ * Returns the noise that goes with an arrow direction
  */
-void show_next_arrow(int cnt) {
-	byte *noise;
-	byte dir = arrows[cnt];
-
+byte *arrow_noise(byte dir) {
 	if (dir == DIRECTION_A) {
-		noise = DIRECTION_A_NOISE;
+		return DIRECTION_A_NOISE;
 	}
 	else if (dir == DIRECTION_B) {
-		noise = DIRECTION_B_NOISE;
+		return DIRECTION_B_NOISE;
 	}
 	else if (dir == DIRECTION_C) {
-		noise = DIRECTION_C_NOISE;
+		return DIRECTION_C_NOISE;
 	}
 	else {
-		noise = DIRECTION_D_NOISE;
+		return DIRECTION_D_NOISE;
+	}
+}
+
+/**
+ * Returns the direction for a button (BTN_A, etc)
+ */
+byte button_direction(byte button) {
+	if (button == BTN_A) {
+		return DIRECTION_A;
+	}
+	else if (button == BTN_B) {
+		return DIRECTION_B;
+	}
+	else if (button == BTN_C) {
+		return DIRECTION_C;
 	}
-	
-	
-	draw_arrow(arrows[cnt], GREEN);
-	delay_ms(200);
-	playsong(noise);
-	delay_ms(200);
-	delay_ms(200);
-	cleardisplay();	
-	delay_ms(200);
+	return DIRECTION_D;
+}
+
+
+/* Button feedback: the arrow for a press is XOR'd on, and XOR'd off again FLASH_MS later */
+#define FLASH_MS	100
+#define FLASH_TIMER	0		// (see starttimer)
 
-	
+static byte flashDir;
+static byte flashOn;
+
+/**
+ * Turns the feedback arrow off (if it's on)
+ */
+void end_flash(void) {
+	if (flashOn) {
+		setdrawmode(DM_XOR);
+		draw_arrow(flashDir, YELLOW);
+		setdrawmode(DM_SET);
+		flashOn = 0;
+	}
 }
 
+/**
+ * Flashes an arrow for a button press and plays its noise.
+ * Only the arrow is touched, so nothing else on the screen is disturbed.
+ */
+void start_flash(byte dir) {
+	end_flash();
+	setdrawmode(DM_XOR);
+	draw_arrow(dir, YELLOW);
+	setdrawmode(DM_SET);
+	playsong(arrow_noise(dir));
+	flashDir = dir;
+	flashOn = 1;
+	starttimer(FLASH_TIMER, FLASH_MS, 0);
+}
+
+
+
 
 //============================================
-// Helper functions drawing large digits
+// Game Screens
 //============================================
 
-void draw_digit_vert_right(int x_shift) {
-	int col3 = 2 + x_shift;
-	drawpoint(col3, 0);
-	drawpoint(col3, 1);
-	drawpoint(col3, 2);
-	drawpoint(col3, 3);
-	drawpoint(col3, 3);
-	drawpoint(col3, 4);
-}
+#define IDLE_DIM_MS		10000	// dim the display after this long without a button press
+#define DIM_BRIGHTNESS	40		// (see setbrightness)
 
-void draw_digit_vert_left(int x_shift) {
-	int col1 = 0 + x_shift;
-	drawpoint(col1, 0);
-	drawpoint(col1, 1);
-	drawpoint(col1, 2);
-	drawpoint(col1, 3);
-	drawpoint(col1, 3);
-	drawpoint(col1, 4);
-}
+#define FRAME_INTERVAL	2		// display cycles per frame (the display refreshes at 100hz)
+#define FRAME_MS		(10 * FRAME_INTERVAL)	// so a frame is this many ms
+#define MS_FRAMES(ms)	((ms) / FRAME_MS)		// for things counted in frames (animation, text)
 
+#define TEXT_COLUMN_MS	100		// how long the scrolling score takes per column
 
-void draw_digit_horiz_top(int x_shift) {
-	int col1 = 0 + x_shift;
-	int col2 = 1 + x_shift;
-	int col3 = 2 + x_shift;
-	drawpoint(col1, 0);
-	drawpoint(col2, 0);
-	drawpoint(col3, 0);
-}
+/* Startup animation: each keyframe is a duration (in frames), 5 green rows, then 5 red rows */
+static const byte ANIM_INTRO[] PROGMEM = {
+	MS_FRAMES(600),	0x70, 0x60, 0x50, 0x08, 0x04,	0, 0, 0, 0, 0,		//DIRECTION_A
+	MS_FRAMES(600),	0x04, 0x08, 0x50, 0x60, 0x70,	0, 0, 0, 0, 0,		//DIRECTION_B
+	MS_FRAMES(600),	0x10, 0x08, 0x05, 0x03, 0x07,	0, 0, 0, 0, 0,		//DIRECTION_C
+	MS_FRAMES(600),	0x07, 0x03, 0x05, 0x08, 0x10,	0, 0, 0, 0, 0,		//DIRECTION_D
+	MS_FRAMES(100),	0, 0, 0, 0, 0,					0, 0, 0, 0, 0,
+	A_END
+};
 
+/* The same, for linked play: C and D are moved left, into the first LINK_XSCREEN columns */
+static const byte ANIM_INTRO_LINKED[] PROGMEM = {
+	MS_FRAMES(600),	0x70, 0x60, 0x50, 0x08, 0x04,	0, 0, 0, 0, 0,		//DIRECTION_A
+	MS_FRAMES(600),	0x04, 0x08, 0x50, 0x60, 0x70,	0, 0, 0, 0, 0,		//DIRECTION_B
+	MS_FRAMES(600),	0x40, 0x20, 0x14, 0x0c, 0x1c,	0, 0, 0, 0, 0,		//DIRECTION_C
+	MS_FRAMES(600),	0x1c, 0x0c, 0x14, 0x20, 0x40,	0, 0, 0, 0, 0,		//DIRECTION_D
+	MS_FRAMES(100),	0, 0, 0, 0, 0,					0, 0, 0, 0, 0,
+	A_END
+};
 
-void draw_digit_horiz_mid(int x_shift) {
-	int col1 = 0 + x_shift;
-	int col2 = 1 + x_shift;
-	int col3 = 2 + x_shift;
-	drawpoint(col1, 2);
-	drawpoint(col2, 2);
-	drawpoint(col3, 2);
+/**
+ * Draws the score (the game over screen) in color clr
+ */
+void draw_score(uint16_t level, byte clr) {
+	cleardisplay();
+	setcolor(clr);
+	if (screenWidth < XSCREEN && level < 10) {
+		drawchar(1, '0' + level);		//one digit, in the middle of the columns we have
+	}
+	else if (screenWidth == XSCREEN && level < 100) {
+		drawchar(4, '0' + (level % 10));
+		drawchar(0, '0' + (level / 10));
+	}
+	else {
+		settextspeed(MS_FRAMES(TEXT_COLUMN_MS));
+		scrollnumber(level);		//too wide for the screen, so it scrolls by
+	}
 }
-void draw_digit_horiz_bot(int x_shift) {
-	int col1 = 0 + x_shift;
-	int col2 = 1 + x_shift;
-	int col3 = 2 + x_shift;
-	drawpoint(col1, 4);
-	drawpoint(col2, 4);
-	drawpoint(col3, 4);
+
+
+
+//============================================
+// Session recording (see miggl-session.c)
+//============================================
+
+#define REPLAY_BUTTONS	(BTN_A | BTN_D)		// hold these at power up to replay the saved game
+
+#ifdef MIGGL_SESSION
+// 2 bytes per button press or release, and level n has n presses, so this holds the
+// first 6 levels.  (a long game is recorded up to where this fills up, and a replay of
+// it hands the buttons back to the player from there.)
+static uint8_t SessionBuf[96];
+static byte recordGames;		// 1 if we record every game (0 if the host build records)
+#endif
+
+/**
+ * Set up recording of the first game - or a replay of the saved one, if the replay
+ * buttons are held down.  (the host build may have set up its own session already.)
+ */
+void setup_session(void) {
+#ifdef MIGGL_SESSION
+	uint16_t len;
+
+	if (getsession() != SES_OFF) {
+		return;
+	}
+	recordGames = 1;
+
+	swapbuffers();		// give the debouncer time to see the buttons
+	swapbuffers();
+	if (getbuttons() == REPLAY_BUTTONS && (len = loadsession(SessionBuf, sizeof(SessionBuf))) != 0) {
+		setsession(SES_REPLAY, SessionBuf, len);
+		while (getbuttons() != 0) {
+			swapbuffers();		// the replay starts once the buttons are let go
+		}
+		flushbuttonevents();
+	}
+	else {
+		setsession(SES_RECORD, SessionBuf, sizeof(SessionBuf));
+	}
+#endif
 }
 
 
+
 //============================================
-// Number Screen
+// High scores (see miggl-nv.c)
 //============================================
-void draw_number(int number, int x_shift) {
-	int col1 = 0 + x_shift;
-	int col2 = 1 + x_shift;
-	int col3 = 2 + x_shift;
-	
-	if (number == 0) {
-		draw_digit_vert_left(x_shift);
-		draw_digit_vert_right(x_shift);
-		draw_digit_horiz_top(x_shift);
-		draw_digit_horiz_bot(x_shift);
-	}
-	else if (number == 1) {
-		drawpoint(col2, 0);
-		drawpoint(col2, 1);
-		drawpoint(col2, 2);
-		drawpoint(col2, 3);
-		drawpoint(col2, 4);
-	}
-	else if (number == 2) {
-		draw_digit_horiz_top(x_shift);
-		drawpoint(col3, 1);
-		draw_digit_horiz_mid(x_shift);
-		drawpoint(col1, 3);
-		draw_digit_horiz_bot(x_shift);
-	}
-	else if (number == 3) {
-		draw_digit_vert_right(x_shift);
-		draw_digit_horiz_top(x_shift);
-		draw_digit_horiz_mid(x_shift);
-		draw_digit_horiz_bot(x_shift);
-	}
-	else if (number == 4) {
-		drawpoint(col1, 0);
-		drawpoint(col1, 1);
-		draw_digit_vert_right(x_shift);
-		draw_digit_horiz_mid(x_shift);
-
-	}
-	else if (number == 5) {
-		draw_digit_horiz_top(x_shift);
-		drawpoint(col1, 1);
-		draw_digit_horiz_mid(x_shift);
-		drawpoint(col3, 3);
-		draw_digit_horiz_bot(x_shift);
-	}
-	else if (number == 6) {
-		draw_digit_vert_left(x_shift);
-		draw_digit_horiz_mid(x_shift);
-		drawpoint(col1, 3);
-		drawpoint(col3, 3);
-		draw_digit_horiz_bot(x_shift);
-	}
-	else if (number == 7) {
-		draw_digit_vert_right(x_shift);
-		draw_digit_horiz_top(x_shift);
-	}
-	else if (number == 8) {
-		draw_digit_vert_left(x_shift);
-		draw_digit_vert_right(x_shift);
-		draw_digit_horiz_top(x_shift);
-		draw_digit_horiz_mid(x_shift);
-		draw_digit_horiz_bot(x_shift);
-	}
-	else if (number == 9) {
-		draw_digit_vert_left(x_shift);
-		drawpoint(col1, 1);
-		drawpoint(col3, 1);
-		draw_digit_horiz_mid(x_shift);
-		draw_digit_horiz_bot(x_shift);
+
+/* What's kept in EEPROM.  (add new things at the end - a different size starts over) */
+struct scores {
+	uint16_t best[3];		// best level, by mode (MODE_NORMAL, etc - see below)
+	uint16_t games;			// games played
+	uint16_t wins;			// games won (MAX_LEVEL)
+	uint32_t levels;		// levels reached, all games (levels / games is the average)
+};
+
+static struct scores Scores;	// (all 0 until something is saved)
+static byte scoresUnsaved;		// 1 if Scores has changed since the last nvsave
+
+void load_scores(void) {
+	nvload(&Scores, sizeof(Scores));
+}
+
+/**
+ * Saves the scores, if they've changed.  (if the last save is still being written,
+ * this does nothing - call it again later.)
+ */
+void save_scores(void) {
+	if (scoresUnsaved && nvsave(&Scores, sizeof(Scores))) {
+		scoresUnsaved = 0;
 	}
+}
 
+/**
+ * Adds a finished game to the scores.  Returns 1 if it's a new best for the mode.
+ */
+byte add_score(byte mode, uint16_t level, byte won) {
+	byte best = 0;
+
+	if (Scores.games != 0xffff) {
+		Scores.games++;
+		Scores.wins += won;
+		Scores.levels += level;
+	}
+	if (level > Scores.best[mode]) {
+		Scores.best[mode] = level;
+		best = 1;
+	}
+	scoresUnsaved = 1;
+	save_scores();
+	return best;
 }
 
 
 
 //============================================
-// Game Screens
+// Main game logic
 //============================================
 
+/*
+ * The game is a state machine, stepped once per frame (see swapbuffers).  No state ever
+ * waits: each one looks at the time it has been in that state (state_time) and at the
+ * button events, does what's due, and returns.
+ */
+#define ST_INTRO		0	// startup animation (any button skips it)
+#define ST_START		1	// short pause, then a new game starts
+#define ST_PLAYBACK		2	// show the arrows so far
+#define ST_INPUT		3	// wait for the player to repeat them
+#define ST_LEVELUP		4	// all correct - add an arrow
+#define ST_GAMEOVER		5	// wrong button
+#define ST_WIN			6	// got them all
+#define ST_SCORE		7	// show the score (any button starts a new game)
+
+#define START_MS		1000	// pause before a game starts
+#define LEVELUP_MS		200		// pause before the level up noise (after the feedback flash)
+#define NEXTLEVEL_MS	400		// pause after it, before the playback
+#define GAMEOVER_MS		400		// pause before the game over music
+#define SCORE_DIM_MS	5000	// the score is dimmed after this long
+#define SCORE_SLEEP_MS	65000	// and then we sleep (display off) until a button is pressed
+#define SCORE_WAKE_MS	10000	// how long the score stays up after that
+#define SCORE_SHOW_MS	2000	// score screen: the score, then the best, this long each
+#define RESTART_MS		1000	// buttons don't start a new game until the score has been up this long
+
+/*
+ * Difficulty: in the playback, each arrow is shown for as long as its tone plays (an 8th
+ * note), then there's a gap.  Both get shorter every level, as set by the game mode.
+ */
+struct gamemode {
+	byte tempo;			// arrow tone tempo at level 1 (bpm)
+	byte tempoStep;		//   bpm faster every level
+	byte maxTempo;		//   up to this (255 at most)
+	byte gap;			// ms between arrows at level 1
+	byte gapStep;		//   ms less every level
+	byte minGap;		//   down to this
+};
+
+#define MODE_NORMAL		0
+#define MODE_RELAXED	1
+#define MODE_FAST		2
+
+static const struct gamemode MODES[] = {
+	{  90, 5, 240,  150, 5,  60 },		// MODE_NORMAL:  level 1 is about 480ms per arrow, level 30 190ms
+	{  74, 2, 160,  250, 5, 100 },		// MODE_RELAXED: about 660ms, then 430ms
+	{ 120, 8, 255,  100, 5,  40 },		// MODE_FAST:    about 350ms, then 160ms
+};
+#define NMODES		(sizeof(MODES) / sizeof(MODES[0]))
+
+/* The mode for the button that starts a game (by direction) */
+static const byte BUTTON_MODES[4] = {
+	MODE_NORMAL,	//DIRECTION_A
+	MODE_RELAXED,	//DIRECTION_B
+	MODE_FAST,		//DIRECTION_C
+	MODE_NORMAL,	//DIRECTION_D
+};
+
+static byte mode = MODE_NORMAL;
+
+static byte state;
+static byte step;				// progress within a state (what's been done so far)
+static uint16_t stateTick;		// when we entered the state (or restarted its timing)
+static uint16_t level;
+static uint16_t cnt;				// arrow being shown (playback), or expected (input)
+static byte arrow;					// the arrow being shown (playback)
+static byte newBest;				// 1 if the game just over has the best score (score screen)
+static byte showingOther;			// 1 if the score screen is showing the other score (best, or the other board's)
+
+void enter_state(byte s) {
+	state = s;
+	step = 0;
+	stateTick = gettick();
+}
+
+uint16_t state_time(void) {
+	return gettick() - stateTick;
+}
+
 /**
- * Shows the startup screen
+ * The arrow tone tempo for this level (bpm)
  */
-void startup_screen() {
-	draw_arrow(DIRECTION_A, GREEN);
-	delay_ms(200);
-	delay_ms(200);
-	delay_ms(200);
-	cleardisplay();
-	draw_arrow(DIRECTION_B, GREEN);
-	delay_ms(200);
-	delay_ms(200);
-	delay_ms(200);
-	cleardisplay();
-	draw_arrow(DIRECTION_C, GREEN);
-	delay_ms(200);
-	delay_ms(200);
-	delay_ms(200);
-	cleardisplay();
-	draw_arrow(DIRECTION_D, GREEN);
-	delay_ms(200);
-	delay_ms(200);
-	delay_ms(200);
-	cleardisplay();
+byte arrow_tempo(void) {
+	const struct gamemode *m = &MODES[mode];
+	uint16_t t;
+
+	t = m->tempo + (level - 1) * m->tempoStep;
+	if (level > 255 || t > m->maxTempo) {		//(level > 255 could overflow t)
+		t = m->maxTempo;
+	}
+	return t;
+}
+
+/**
+ * The gap after each arrow for this level (ms)
+ */
+byte arrow_gap(void) {
+	const struct gamemode *m = &MODES[mode];
+	uint16_t less;
+
+	less = (level - 1) * m->gapStep;
+	if (level > 255 || less > m->gap - m->minGap) {
+		return m->minGap;
+	}
+	return m->gap - less;
+}
+
+/**
+ * Plays the tone for an arrow (at the tempo set by the playback)
+ */
+void play_arrow_tone(byte dir) {
+	ARROW_TONE[0] = arrow_noise(dir)[0];
+	playsong(ARROW_TONE);
 }
 
+/*
+ * Head to head (see miggl-link.c): hold LINK_BUTTONS at power up, with another board on
+ * the serial port.  When both are ready for a game (ST_START), they send each other a
+ * seed, and both play the sequence from the two seeds XOR'd together.  Every press goes
+ * to the other board, which keeps its own copy of the sequence to follow along (so a
+ * move is only the message type - 2 bytes on the line).  The higher level wins.
+ */
+#define LINK_BUTTONS	(BTN_B | BTN_C)
+
+#define M_MOVE			0		// a press: M_MOVE + direction (0 to 3)
+#define M_START			4		// ready for a new game: seed (2 bytes, high byte first), mode
+#define M_SCORE			5		// game over: level (2 bytes)
+
+static byte linked;				// 1 if we play against another board
+static byte startSent;			// 1 if we've sent M_START, and don't have the other board's yet
+static byte peerStarted;		// 1 if we have the other board's M_START, and haven't sent ours yet
+static byte paired;				// 1 once both have been sent (the game can start)
+static uint16_t startSeed;		// our seed (in M_START)
+static byte startMode;			// our mode (in M_START)
+static uint16_t peerSeed;		// the other board's
+static byte peerMode;
+static uint16_t linkSeed;		// the game's seed, with the mode in the top 2 bits (see new_game)
+static uint16_t linkRestarts;	// linkstats.restarts, as of the last poll_link
+
+static uint16_t oppLevel;		// the other board's level
+static uint16_t oppCnt;			// the arrow it's on
+static uint16_t oppState;		// its sequence generator (see seq_next)
+static byte oppDone = 1;		// 1 once its game is over
+static uint16_t shownOpp;		// oppLevel and oppDone, as shown on the score screen
+static byte shownOppDone;
 
 /**
- * Shows the game over screen
+ * Link up with another board, if the link buttons are held down
  */
-void gameover_screen(int level) {
-	setcolor(RED);
-	draw_number((level % 10), 4);
-	draw_number((level / 10), 0);
+void setup_link(void) {
+	swapbuffers();		// give the debouncer time to see the buttons
+	swapbuffers();
+	if (getbuttons() != LINK_BUTTONS || getsession() == SES_REPLAY) {
+		return;
+	}
+	linkinit();
+	linked = 1;
+	screenWidth = LINK_XSCREEN;
+	while (getbuttons() != 0) {
+		swapbuffers();
+	}
+	flushbuttonevents();
 }
 
+/**
+ * Both boards are ready: work out the game's seed (and mode - if they don't agree, it's
+ * normal), and start following the other board's game
+ */
+void pair_games(void) {
+	byte m;
 
+	m = (startMode == peerMode) ? startMode : MODE_NORMAL;
+	linkSeed = ((startSeed ^ peerSeed) & 0x3fff) | ((uint16_t)m << 14);
+	if (linkSeed == 0) {
+		linkSeed = 0x110D;		//(as seq_init does)
+	}
+	startSent = 0;
+	peerStarted = 0;
+	paired = 1;
 
+	oppLevel = 1;
+	oppCnt = 0;
+	oppDone = 0;
+}
 
-//============================================
-// Main game logic
-//============================================
+/**
+ * Sends our M_START (with a new seed).  Returns 0 if the link is busy.
+ */
+byte send_start(void) {
+	byte d[3];
 
-int main(void) {
 	init_random();
-	avrinit();
-	int cnt;
-	byte btnDown = 0;
-	byte level = 1;
-	arrows[0] = DIRECTIONS[next_random(4)];
-
-	initswapbuffers();
-	swapinterval(10);		// note: display refresh is 100hz (lower number speeds up game)
+	startSeed = get_random_seed();
+	startMode = mode;
+	d[0] = startSeed >> 8;
+	d[1] = startSeed;
+	d[2] = startMode;
+	if (!linksend(M_START, d, 3)) {
+		return 0;
+	}
+	startSent = 1;
+	if (peerStarted) {
+		pair_games();
+	}
+	return 1;
+}
+
+/**
+ * The other board pressed a button: check it against its copy of the sequence
+ */
+void opp_move(byte dir) {
+	if (oppDone) {
+		return;
+	}
+	if (oppCnt == 0) {
+		oppState = linkSeed;		//(see seq_reset)
+	}
+	if (DIRECTIONS[random_below(&oppState, 4)] != dir) {
+		oppDone = 1;				//(its M_SCORE will say so too)
+	}
+	else if (++oppCnt == oppLevel) {
+		oppCnt = 0;
+		if (oppLevel == MAX_LEVEL) {
+			oppDone = 1;
+		}
+		else {
+			oppLevel++;
+		}
+	}
+}
+
+/**
+ * Reads the other board's messages (every frame, when linked)
+ */
+void poll_link(void) {
+	struct linkmsg m;
+	struct linkstats ls;
+
+	//if the other board has started over, it lost what we sent it - and its game
+	getlinkstats(&ls);
+	if (ls.restarts != linkRestarts) {
+		linkRestarts = ls.restarts;
+		peerStarted = 0;
+		oppDone = 1;
+		if (state == ST_START) {
+			startSent = 0;
+			paired = 0;
+			step = 0;		//(sends M_START again)
+		}
+	}
+
+	while (linkrecv(&m)) {
+		if (m.type < M_START) {
+			opp_move(m.type - M_MOVE);
+		}
+		else if (m.type == M_START && m.len == 3) {
+			peerSeed = ((uint16_t)m.data[0] << 8) | m.data[1];
+			peerMode = m.data[2];
+			peerStarted = 1;
+			if (startSent) {
+				pair_games();
+			}
+		}
+		else if (m.type == M_SCORE && m.len == 2) {
+			oppLevel = ((uint16_t)m.data[0] << 8) | m.data[1];
+			oppDone = 1;
+		}
+	}
+}
+
+/**
+ * The color of score a, against score b (the other one on the score screen): green if it
+ * wins, red if it loses, and yellow for a tie - or if the other board is still playing,
+ * and hasn't got past us yet
+ */
+byte versus_color(uint16_t a, uint16_t b) {
+	if (a == b || (!oppDone && oppLevel <= level)) {
+		return YELLOW;
+	}
+	return (a > b) ? GREEN : RED;
+}
+
+
+/**
+ * Starts a new game
+ */
+void new_game(void) {
+	uint16_t seed;
+
+#ifdef MIGGL_SESSION
+	if (recordGames && getsession() == SES_OFF) {
+		setsession(SES_RECORD, SessionBuf, sizeof(SessionBuf));
+	}
+#endif
+	//a replay brings its own seed.  (the mode is in the top 2 bits, so it replays in the same mode)
+	init_random();
+	seed = (get_random_seed() & 0x3fff) | ((uint16_t)mode << 14);
+	if (linked) {
+		seed = linkSeed;		//(the same as the other board's)
+		paired = 0;
+	}
+	seed = startsession(seed);
+	mode = seed >> 14;
+	if (mode >= NMODES) {
+		mode = MODE_NORMAL;
+	}
+	seq_init(seed);
+	flushbuttonevents();
+
+	level = 1;
+	cnt = 0;
 	cleardisplay();
-	start_timer1();			// this starts display refresh and audio processing
-	button_init();
-	initaudio();			// XXX eventually, we remove this!
-
-	playsong(SONG_INTRO);
-	startup_screen();
-	delay_sec(1);
-
-
-	//~~~ GOTO: NEXT LEVEL ~~~
-	nextlevel:
-		cleardisplay();
-		
-		//show all of the arrows in our history
-		for(cnt=0; cnt<level; cnt++) {
-			show_next_arrow(cnt);
+	enter_state(ST_PLAYBACK);
+}
+
+/**
+ * The number on the score screen: the score, or the other score - the best score for
+ * the mode, or when linked, the other board's level
+ */
+uint16_t score_number(byte other) {
+	if (!other) {
+		return level;
+	}
+	return linked ? oppLevel : Scores.best[mode];
+}
+
+/**
+ * Shows the score - or the other score (see score_number).  The best score is green.
+ * When linked, the winner's is green and the loser's red (see versus_color).
+ */
+void show_score(byte other) {
+	byte clr;
+
+	if (linked) {
+		clr = other ? versus_color(oppLevel, level) : versus_color(level, oppLevel);
+	}
+	else {
+		clr = other ? GREEN : (newBest ? YELLOW : RED);
+	}
+	draw_score(score_number(other), clr);
+	showingOther = other;
+	shownOpp = oppLevel;
+	shownOppDone = oppDone;
+}
+
+/**
+ * The game is over: add it to the scores (unless it was a replay), tell the other board
+ * (if linked), save the recording, and show the score
+ */
+void end_game(byte won) {
+	byte d[2];
+
+	newBest = 0;
+	if (getsession() != SES_REPLAY) {
+		newBest = add_score(mode, level, won);
+	}
+	if (linked) {
+		d[0] = level >> 8;
+		d[1] = level;
+		linksend(M_SCORE, d, 2);		//(if the link is busy, the moves have told it anyway)
+	}
+#ifdef MIGGL_SESSION
+	savesession();		//(both are written in the background)
+#endif
+	show_score(0);
+	enter_state(ST_SCORE);
+}
+
+/**
+ * One frame of the game
+ */
+void step_game(void) {
+	struct buttonevent ev;
+	byte dir, other;
+
+	if (linked) {
+		poll_link();
+	}
+
+	switch (state) {
+	case ST_INTRO:
+		if (step == 0) {
+			play_music(SONG_INTRO);
+			playanim(linked ? ANIM_INTRO_LINKED : ANIM_INTRO);
+			step = 1;
+		}
+		if (getbuttonevent(&ev) && ev.type == BE_PRESS) {
+			mode = BUTTON_MODES[button_direction(ev.button)];
+			stopanim();
+			cleardisplay();
+		}
+		if (!isanimplaying()) {
+			enter_state(ST_START);
+		}
+		break;
+
+	case ST_START:
+		while (getbuttonevent(&ev)) {
+			if (ev.type == BE_PRESS && !startSent && !paired) {
+				mode = BUTTON_MODES[button_direction(ev.button)];
+			}
+		}
+		if (linked) {
+			//wait for the other board (the pause starts once it's ready too)
+			if (step == 0 && send_start()) {
+				step = 1;
+			}
+			if (!paired) {
+				stateTick = gettick();
+				break;
+			}
+		}
+		if (state_time() >= START_MS) {
+			new_game();
 		}
-		
-		cnt = 0;
-	
-		while(1) {
+		break;
+
+	case ST_PLAYBACK:
+		//show all of the arrows in the sequence: each one is up while its tone plays,
+		//then after the gap, the next one (and its tone) starts in the same frame
+		if (step == 1 && !isaudioplaying()) {
 			cleardisplay();
-			handlebuttons();
-			
-			//look for button presses and compare to history
-			if (!btnDown) {
-
-				//make sure we only count long button presses once
-				if (ButtonA || ButtonB || ButtonC || ButtonD) {
-					btnDown = 1;			
-				}
-	
-		
-				if (ButtonA) {
-					draw_arrow(DIRECTION_A, YELLOW);
-					playsong(DIRECTION_A_NOISE);
-					delay_ms(100);
-					if (arrows[cnt] == DIRECTION_A) {
-						cnt++;
-					}
-					else {
-						goto gameover;
-					}
-		
-				}
-				if (ButtonB) {
-					draw_arrow(DIRECTION_B, YELLOW);
-					playsong(DIRECTION_B_NOISE);
-					delay_ms(100);
-					if (arrows[cnt] == DIRECTION_B) {
-						cnt++;
-					}
-					else {
-						goto gameover;
-					}
-		
-				}
-		
-				if (ButtonC) {
-					draw_arrow(DIRECTION_C, YELLOW);
-					playsong(DIRECTION_C_NOISE);
-					delay_ms(100);
-					if (arrows[cnt] == DIRECTION_C) {
-						cnt++;
-					}
-					else {
-						goto gameover;
-					}
-		
-				}
-				if (ButtonD) {
-					draw_arrow(DIRECTION_D, YELLOW);
-					playsong(DIRECTION_D_NOISE);
-					delay_ms(100);
-					if (arrows[cnt] == DIRECTION_D) {
-						cnt++;
-					}
-					else {
-						goto gameover;
-					}
-				
-				}
-				
-	
-				//this is the last arrow in the history, add another to the list?
-				if (cnt == level) {
-					if (level == 99) {
-						goto gamewin;
-					}
-					cleardisplay();
-					delay_ms(200);
-					playsong(CORRECT_NOISE);
-					level++;
-					arrows[cnt] = DIRECTIONS[next_random(4)];
-					delay_ms(200);
-					delay_ms(200);
-					goto nextlevel;
-				}
-	
+			step = 2;
+			stateTick = gettick();
+		}
+		if (step == 2 && state_time() >= arrow_gap()) {
+			step = 0;
+			if (++cnt == level) {
+				cnt = 0;
+				seq_reset();
+				flushbuttonevents();		//presses during the playback don't count
+				enter_state(ST_INPUT);
+				break;
 			}
-			else {
-				if (!ButtonA && !ButtonB && !ButtonC && !ButtonD) {
-					btnDown = 0;
-				}
+		}
+		if (step == 0) {
+			if (cnt == 0) {
+				seq_reset();
+				settempo(arrow_tempo());
 			}
-	
-			
-	
+			arrow = seq_next();
+			draw_arrow(arrow, GREEN);
+			play_arrow_tone(arrow);
+			step = 1;
+		}
+		break;
+
+	case ST_INPUT:
+		//dim the display if nobody is playing
+		if (state_time() > IDLE_DIM_MS) {
+			setbrightness(DIM_BRIGHTNESS);
 		}
-		
-	//~~~ GOTO: GAME WIN ~~~
-	gamewin:
-		cleardisplay();
-		//do something;
-		playsong(SONG_WIN);
-		gameover_screen(level);
-		return (0);
-	
-	//~~~ GOTO: GAME OVER ~~~
-	gameover:
-		cleardisplay();
-		delay_ms(200);
-		delay_ms(200);
-		playsong(SONG_TAPS);
-		gameover_screen(level);
-		return (0);
+
+		//look for button presses and compare to the sequence
+		while (state == ST_INPUT && getbuttonevent(&ev)) {
+			if (ev.type != BE_PRESS) {
+				continue;
+			}
+			setbrightness(255);
+			stateTick = gettick();
+
+			dir = button_direction(ev.button);
+			start_flash(dir);
+			if (linked) {
+				linksend(M_MOVE + dir, NULL, 0);
+			}
+			if (seq_next() != dir) {
+				enter_state(ST_GAMEOVER);
+			}
+			//this is the last arrow so far, add another?
+			else if (++cnt == level) {
+				enter_state(level == MAX_LEVEL ? ST_WIN : ST_LEVELUP);
+			}
+		}
+		break;
+
+	case ST_LEVELUP:
+		if (step == 0 && !flashOn) {
+			cleardisplay();
+			step = 1;
+			stateTick = gettick();
+		}
+		if (step == 1 && state_time() >= LEVELUP_MS) {
+			play_music(CORRECT_NOISE);
+			level++;			//(the sequence just goes one further)
+			step = 2;
+		}
+		if (step == 2 && state_time() >= LEVELUP_MS + NEXTLEVEL_MS) {
+			cnt = 0;
+			enter_state(ST_PLAYBACK);
+		}
+		break;
+
+	case ST_GAMEOVER:
+		if (step == 0 && !flashOn) {
+			cleardisplay();
+			step = 1;
+			stateTick = gettick();
+		}
+		if (step == 1 && state_time() >= GAMEOVER_MS) {
+			play_music(SONG_TAPS);
+			end_game(0);
+		}
+		break;
+
+	case ST_WIN:
+		if (!flashOn) {
+			cleardisplay();
+			//do something;
+			play_music(SONG_WIN);
+			end_game(1);
+		}
+		break;
+
+	case ST_SCORE:
+		save_scores();		//(if the last save was busy)
+
+		//take turns showing the score and the other score (a scrolling one goes all the way by first).
+		//the other board's level is kept up to date as it plays
+		if (!istextscrolling()) {
+			other = (linked || !newBest) && ((state_time() / SCORE_SHOW_MS) & 1);
+			if (other != showingOther || score_number(other) >= 100 ||
+				oppLevel != shownOpp || oppDone != shownOppDone) {
+				show_score(other);		//(a scrolling score keeps scrolling by)
+			}
+		}
+
+		if (state_time() >= SCORE_SLEEP_MS && (!linked || oppDone)) {
+			//save some power: sleep with the display off - any button shows the score again for a bit
+			sleepuntilbutton();
+			flushbuttonevents();
+			stateTick = gettick() - (SCORE_SLEEP_MS - SCORE_WAKE_MS);
+		}
+		else if (state_time() >= SCORE_DIM_MS) {
+			setbrightness(DIM_BRIGHTNESS);
+		}
+
+		//any button starts a new game (once the score has been seen)
+		while (getbuttonevent(&ev)) {
+			if (ev.type == BE_PRESS && state_time() >= RESTART_MS) {
+				mode = BUTTON_MODES[button_direction(ev.button)];
+				setbrightness(255);
+				cleardisplay();
+				enter_state(ST_START);
+				break;
+			}
+		}
+		break;
+	}
+}
+
+
+int main(void) {
+	miggl_init();
+	swapinterval(FRAME_INTERVAL);
+	setinputmode(INPUT_PCINT);	// buttons are seen right away, even between frames
+	setup_link();
+	setup_session();
+	load_scores();
+
+	enter_state(ST_INTRO);
+	miggl_onframe(step_game);		// (the CPU sleeps between frames)
+	miggl_ontimer(FLASH_TIMER, end_flash);	// the feedback arrow's time is up
+	miggl_run();
+	return 0;
 }
@@ -0,0 +1,167 @@
+/*
+ *	uart.c - interrupt driven UART driver (atmega88 USART0), 8N1
+ *
+ *	author(s): jesse fulton (jesse.fulton at gmail dot com) (c) 2010 - Some Rights Reserved
+ *
+ *	Note: This source code is licensed under a Creative Commons License, CC-by-nc-sa.
+ *		(attribution, non-commercial, share-alike)
+ *  	see http://creativecommons.org/licenses/by-nc-sa/3.0/ for details.
+ *
+ *
+ *	received bytes go into a buffer from the receive interrupt, and bytes to send are taken
+ *	from a buffer by the data register empty interrupt, so nothing here waits for the line
+ *	(except uart_putchar/uart_getchar, for stdio).  UDR0 is only touched from the interrupts.
+ *
+ *	the baud rate is UART_BAUD (uart.h), in double speed mode (U2X0), which is closer to the
+ *	standard rates from 8mhz: 9600 and 38400 are 0.2% off, 57600 is 2.1% off.
+ *
+ *	note: on the Mignonette, RXD and TXD (PD0, PD1) are also display rows ROW1 and ROW2 -
+ *	the two right hand columns of pixels.  while the UART is on, it has those pins: the
+ *	columns show the serial lines, not the picture.  linkinit() (miggl-link.c) has the display
+ *	scan leave those pins alone, so it doesn't switch the RXD pullup.  (see iodefs.h)
+ *
+ *
+ *	revision history:
+ *
+ *	- oct 18, 2026 - jesse
+ *		note that the display scan leaves RXD and TXD alone while the link is on.
+ *
+ *	- oct 18, 2026 - jesse
+ *		created.  (uart.h was the avr-libc stdio demo's - its uart.c was never part of this.)
+ *
+ *
+ */
+
+#include <inttypes.h>
+#include <avr/io.h>			/* this takes care of definitions for our specific AVR */
+#include <avr/interrupt.h>	/* for cli(), ISR, etc */
+#include <avr/sleep.h>		/* for sleep_mode() */
+#include <stdio.h>			// for FILE
+
+#include "uart.h"
+
+
+#define UBRR_VALUE		((F_CPU + 4UL * UART_BAUD) / (8UL * UART_BAUD) - 1)	// (rounded, for U2X0)
+
+static volatile uint8_t RxBuf[RX_BUFSIZE];
+static volatile uint8_t RxHead, RxTail;			// the ISR adds at RxHead
+static volatile uint8_t TxBuf[TX_BUFSIZE];
+static volatile uint8_t TxHead, TxTail;			// the ISR takes from TxTail
+
+
+void uart_init(void)
+{
+	uint8_t sreg;
+
+	sreg = SREG;
+	cli();
+	RxHead = RxTail = 0;
+	TxHead = TxTail = 0;
+
+	UBRR0 = UBRR_VALUE;
+	UCSR0A = _BV(U2X0);
+	UCSR0C = _BV(UCSZ01) | _BV(UCSZ00);			// 8 data bits, no parity, 1 stop bit
+	UCSR0B = _BV(RXEN0) | _BV(TXEN0) | _BV(RXCIE0);
+	SREG = sreg;
+}
+
+void uart_stop(void)
+{
+	UCSR0B = 0;
+}
+
+
+//
+// received a byte (if the buffer is full, it's dropped)
+//
+ISR(USART_RX_vect)
+{
+	uint8_t c, head;
+
+	c = UDR0;
+	head = (RxHead + 1) & (RX_BUFSIZE-1);
+	if (head != RxTail) {
+		RxBuf[RxHead] = c;
+		RxHead = head;
+	}
+}
+
+//
+// ready for the next byte to send
+//
+ISR(USART_UDRE_vect)
+{
+	if (TxHead == TxTail) {
+		UCSR0B &= ~_BV(UDRIE0);			// nothing left
+		return;
+	}
+	UDR0 = TxBuf[TxTail];
+	TxTail = (TxTail + 1) & (TX_BUFSIZE-1);
+}
+
+
+uint8_t uart_put(uint8_t c)
+{
+	uint8_t sreg, head;
+
+	sreg = SREG;
+	cli();
+	head = (TxHead + 1) & (TX_BUFSIZE-1);
+	if (head == TxTail) {
+		SREG = sreg;
+		return 0;
+	}
+	TxBuf[TxHead] = c;
+	TxHead = head;
+	UCSR0B |= _BV(UDRIE0);				// (the interrupt comes as soon as UDR0 is free)
+	SREG = sreg;
+	return 1;
+}
+
+uint8_t uart_txfree(void)
+{
+	return (TxTail - TxHead - 1) & (TX_BUFSIZE-1);
+}
+
+int uart_get(void)
+{
+	uint8_t sreg, c;
+
+	sreg = SREG;
+	cli();
+	if (RxHead == RxTail) {
+		SREG = sreg;
+		return -1;
+	}
+	c = RxBuf[RxTail];
+	RxTail = (RxTail + 1) & (RX_BUFSIZE-1);
+	SREG = sreg;
+	return c;
+}
+
+
+//
+// stdio (e.g. fdevopen(uart_putchar, uart_getchar)) - these wait
+//
+int uart_putchar(char c, FILE *stream)
+{
+	if (c == '\n') {
+		uart_putchar('\r', stream);
+	}
+	while (!uart_put(c)) {
+		set_sleep_mode(SLEEP_MODE_IDLE);
+		sleep_mode();			// (until an interrupt - e.g. the byte going out)
+	}
+	return 0;
+}
+
+int uart_getchar(FILE *stream)
+{
+	int c;
+
+	while ((c = uart_get()) < 0) {
+		set_sleep_mode(SLEEP_MODE_IDLE);
+		sleep_mode();
+	}
+	return c;
+}
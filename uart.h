@@ -9,14 +9,29 @@
  * Stdio demo, UART declarations
  *
  * $Id: uart.h,v 1.1.2.1 2005/12/28 22:35:08 joerg_wunsch Exp $
+ *
+ * - oct 18, 2026 - jesse
+ *	the buffers are 16 bytes (RAM is short - a link frame is at most 9).
+ *
+ * - oct 18, 2026 - jesse
+ *	the driver is uart.c now (interrupt driven, with receive and transmit buffers).
+ *	UART_BAUD can be set on the compiler command line.  add uart_put(), uart_get(), etc.
  */
 
 /* CPU frequency */
 #define F_CPU 8000000UL
 //#define F_CPU 1000000UL
 
-/* UART baud rate */
+/* UART baud rate - may be overridden on the compiler command line (e.g. -DUART_BAUD=38400) */
+#ifndef UART_BAUD
 #define UART_BAUD  9600
+#endif
+
+/*
+ * Size of the receive and transmit buffers (must be a power of 2).
+ */
+#define RX_BUFSIZE 16
+#define TX_BUFSIZE 16
 
 /*
  * Perform UART startup initialization.
@@ -24,18 +39,28 @@
 void	uart_init(void);
 
 /*
- * Send one character to the UART.
+ * Turn the UART off (its pins go back to being port pins).
  */
-int	uart_putchar(char c, FILE *stream);
+void	uart_stop(void);
 
 /*
- * Size of internal line buffer used by uart_getchar().
+ * Queue one byte to send.  Returns 0 if the transmit buffer is full.
+ * (uart_txfree() says how much room there is.)
  */
-#define RX_BUFSIZE 80
+uint8_t	uart_put(uint8_t c);
+uint8_t	uart_txfree(void);
+
+/*
+ * Get one received byte.  Returns -1 if there isn't one.
+ */
+int	uart_get(void);
+
+/*
+ * Send one character to the UART.  (waits if the transmit buffer is full)
+ */
+int	uart_putchar(char c, FILE *stream);
 
 /*
- * Receive one character from the UART.  The actual reception is
- * line-buffered, and one character is returned from the buffer at
- * each invokation.
+ * Receive one character from the UART.  (waits for one - no line buffering)
  */
 int	uart_getchar(FILE *stream);